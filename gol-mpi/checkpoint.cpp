@@ -0,0 +1,153 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "checkpoint.hpp"
+#include "field_io.hpp"
+
+const char kManifestMagic[4] = {'G', 'O', 'L', 'M'};
+const uint32_t kManifestVersion = 1;
+
+namespace {
+
+// Заголовок манифеста. За ним следуют точки: номер итерации, слот, число
+// участков и их границы (все по 8 байт).
+struct ManifestHeader {
+  char magic_[4];           // "GOLM"
+  uint32_t version_;
+  uint64_t height_;
+  uint64_t width_;
+  uint32_t entries_count_;
+  uint32_t reserved_;
+  char rules_[32];
+};
+
+// Чтение участков точки entry в соответствующие строки field.
+bool LoadCheckpointEntry(const std::string& filename,
+                         const CheckpointEntry& entry,
+                         CyclicVector<CyclicVector<char>>& field) {
+  for (size_t i = 0; i + 1 < entry.borders_.size(); ++i) {
+    MappedFile file(CheckpointStripName(filename, entry.slot_, i));
+    CyclicVector<CyclicVector<char>> strip;
+    std::string rules;
+    size_t generation = 0;
+    if (!LoadBinaryBoard(file, strip, rules, generation) ||
+        generation != entry.generation_ ||
+        static_cast<long long>(strip.size()) !=
+            entry.borders_[i + 1] - entry.borders_[i] ||
+        strip[0].size() != field[0].size()) {
+      return false;
+    }
+    for (size_t j = 0; j < strip.size(); ++j) {
+      field[entry.borders_[i] + j].swap(strip[j]);
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+std::string CheckpointStripName(const std::string& filename, const size_t slot,
+                                const size_t index) {
+  return filename + "." + std::to_string(slot) + "." + std::to_string(index);
+}
+
+bool SaveCheckpointManifest(const std::string& filename, const size_t height,
+                            const size_t width, const std::string& rules,
+                            const std::vector<CheckpointEntry>& entries) {
+  std::string temporary = filename + ".tmp";
+  {
+    std::ofstream fout(temporary, std::ios::binary | std::ios::trunc);
+    if (!fout) {
+      return false;
+    }
+    ManifestHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic_, kManifestMagic, sizeof(kManifestMagic));
+    header.version_ = kManifestVersion;
+    header.height_ = height;
+    header.width_ = width;
+    header.entries_count_ = static_cast<uint32_t>(entries.size());
+    std::strncpy(header.rules_, rules.c_str(), sizeof(header.rules_) - 1);
+    fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    for (const auto& entry : entries) {
+      uint64_t values[3] = {entry.generation_, entry.slot_,
+                            entry.borders_.size() - 1};
+      fout.write(reinterpret_cast<const char*>(values), sizeof(values));
+      fout.write(reinterpret_cast<const char*>(entry.borders_.data()),
+                 entry.borders_.size() * sizeof(long long));
+    }
+    fout.close();
+    if (!fout) {
+      std::remove(temporary.c_str());
+      return false;
+    }
+  }
+  return std::rename(temporary.c_str(), filename.c_str()) == 0;
+}
+
+bool IsCheckpointManifest(const std::string& filename) {
+  MappedFile file(filename);
+  return file.IsOpen() && file.Size() >= sizeof(ManifestHeader) &&
+         std::memcmp(file.Data(), kManifestMagic, sizeof(kManifestMagic)) == 0;
+}
+
+bool LoadCheckpoint(const std::string& filename,
+                    CyclicVector<CyclicVector<char>>& field,
+                    std::string& rules, size_t& generation) {
+  if (!IsCheckpointManifest(filename)) {
+    return false;
+  }
+  MappedFile file(filename);
+  ManifestHeader header;
+  std::memcpy(&header, file.Data(), sizeof(header));
+  if (header.version_ != kManifestVersion || header.height_ == 0 ||
+      header.width_ == 0) {
+    return false;
+  }
+
+  // Разбор точек с проверкой выхода за конец файла.
+  std::vector<CheckpointEntry> entries;
+  const char* data = file.Data() + sizeof(header);
+  const char* end = file.Data() + file.Size();
+  for (uint32_t i = 0; i < header.entries_count_; ++i) {
+    uint64_t values[3];
+    if (static_cast<size_t>(end - data) < sizeof(values)) {
+      return false;
+    }
+    std::memcpy(values, data, sizeof(values));
+    data += sizeof(values);
+    if (values[2] == 0 ||
+        static_cast<size_t>(end - data) / sizeof(long long) < values[2] + 1) {
+      return false;
+    }
+    CheckpointEntry entry;
+    entry.generation_ = values[0];
+    entry.slot_ = values[1];
+    entry.borders_.resize(values[2] + 1);
+    std::memcpy(entry.borders_.data(), data,
+                entry.borders_.size() * sizeof(long long));
+    data += entry.borders_.size() * sizeof(long long);
+    if (entry.borders_.front() != 0 ||
+        entry.borders_.back() != static_cast<long long>(header.height_)) {
+      return false;
+    }
+    entries.push_back(std::move(entry));
+  }
+
+  for (const auto& entry : entries) {
+    field.assign(header.height_, CyclicVector<char>());
+    for (auto& line : field) {
+      line.assign(header.width_, 0);
+    }
+    if (LoadCheckpointEntry(filename, entry, field)) {
+      header.rules_[sizeof(header.rules_) - 1] = '\0';
+      rules = header.rules_;
+      generation = entry.generation_;
+      return true;
+    }
+  }
+  field.clear();
+  return false;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string>
+#include <vector>
+
+#include "cyclic_vector.hpp"
+
+// Контрольная точка распределенного поля. Каждый раб пишет свой участок в
+// отдельный двоичный файл поля <filename>.<slot>.<номер раба>, а манифест
+// <filename> хранит номер итерации, слот и границы участков. Слоты
+// чередуются, и манифест помнит также предыдущую точку: если запись новой
+// не успела закончиться, поле восстанавливается из предыдущей.
+
+// Одна контрольная точка манифеста.
+struct CheckpointEntry {
+  uint64_t generation_;
+  uint64_t slot_;
+  // Границы участков в глобальной нумерации строк, участков на один меньше.
+  std::vector<long long> borders_;
+};
+
+// Имя файла участка index контрольной точки filename в слоте slot.
+std::string CheckpointStripName(const std::string& filename, const size_t slot,
+                                const size_t index);
+
+// Запись манифеста через временный файл. Точки перечисляются от новой к
+// старой.
+bool SaveCheckpointManifest(const std::string& filename, const size_t height,
+                            const size_t width, const std::string& rules,
+                            const std::vector<CheckpointEntry>& entries);
+
+// Является ли файл манифестом контрольной точки.
+bool IsCheckpointManifest(const std::string& filename);
+
+// Сборка поля из самой новой целой контрольной точки манифеста.
+bool LoadCheckpoint(const std::string& filename,
+                    CyclicVector<CyclicVector<char>>& field,
+                    std::string& rules, size_t& generation);
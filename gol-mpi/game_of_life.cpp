@@ -1,52 +1,110 @@
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cmath>
 #include <iostream>
-#include <fstream>
 #include <random>
+#include <thread>
 #include <utility>
 
 #include "mpi.h"
+#include "checkpoint.hpp"
+#include "field_io.hpp"
 #include "game_of_life.hpp"
+#include "kernel.hpp"
+#include "row_codec.hpp"
 
+// Теги сообщений между процессами.
 enum MpiGolTag : int {
+  Update,
+  FieldSize,
+  Field,
+  DirtyRows,
+  HaloUp,    // первая строка участка, уходит предыдущему рабу
+  HaloDown,  // последняя строка участка, уходит следующему рабу
+  Balance,
+  Rules,
+  Checkpoint,
+  Stats,
+  CensusSeries
+};
+
+// Команды мастера, рассылаемые по управляющему коммуникатору.
+enum class MpiGolCommand : unsigned long {
   Start,
   Run,
+  Running,
   Stop,
   Update,
   Quit,
-  FieldSize,
-  Field,
-  Running
+  Checkpoint,
+  AutoCheckpoint,
+  Stats,  // Аргумент: 0 - прислать статистику мастеру, 1 - сбросить ее.
+  Census,  // Аргумент: число последних сводок, которые нужно прислать.
+  CensusRecord,
+  Edit  // Аргумент: число правок.
 };
 
-GameOfLife::GameOfLife(const std::string& rules)
+// Длина строки правил, рассылаемой рабам.
+const int kRulesLength = sizeof(BoardHeader::rules_);
+
+// Размер заголовка сегмента общей памяти раба.
+const size_t kSharedHeaderSize = 2 * sizeof(unsigned long);
+
+// Описание участка раба для манифеста контрольной точки: признак целой
+// предыдущей точки в том же файле, ее итерация, слот, первая строка и число
+// строк участка, затем то же для новой точки.
+const int kCheckpointInfoSize = 9;
+
+// Размер статистики раба: байты обмена границами и гистограммы этапов.
+const int kStatsSize = 2 + 3 * TimeHistogram::kSavedSize;
+
+// Индексы запросов в control_requests_.
+const int kCommandRequest = 0;
+const int kReduceRequest = 1;
+const int kBarrierRequest = 2;
+
+// Число итераций между перераспределениями строк между рабами.
+const size_t kBalancePeriod = 64;
+// Перекос времени счета относительно среднего, после которого строки
+// перераспределяются.
+const double kBalanceThreshold = 1.1;
+
+GameOfLife::GameOfLife(const std::string& rules, const HaloMode halo_mode,
+                       const bool shared_memory, const bool sparse_rows)
     : iterations_count_(0),
       desired_iterations_count_(0),
       running_(false),
-      up_to_date_(true) {
-  bool set_born = true;
-  for (const auto& c : rules) {
-    if (c == 'b' || c == 'B') {
-      set_born = true;
-    } else if (c == 's' || c == 'S') {
-      set_born = false;
-    } else if (c == '/') {
-      set_born = !set_born;
-      continue;
-    } else if (c >= '0' && c <= '9') {
-      if (set_born) {
-        rules_.born_.push_back(c - '0');
-      } else {
-        rules_.stay_.push_back(c - '0');
-      }
-    }
+      up_to_date_(true),
+      global_offset_(0),
+      slaves_comm_(MPI_COMM_NULL),
+      control_comm_(MPI_COMM_NULL),
+      stop_state_(StopState::None),
+      halo_mode_(halo_mode),
+      sparse_rows_(sparse_rows),
+      halo_window_(MPI_WIN_NULL),
+      halo_flags_window_(MPI_WIN_NULL),
+      shared_memory_(shared_memory),
+      node_comm_(MPI_COMM_NULL),
+      shared_window_(MPI_WIN_NULL),
+      shared_segment_(nullptr),
+      calculation_time_(0),
+      halo_bytes_sent_(0),
+      halo_bytes_received_(0),
+      census_generation_(0),
+      auto_checkpoint_every_(0),
+      checkpoint_slot_(0),
+      checkpoint_generation_(0),
+      checkpoint_offset_(0),
+      checkpoint_rows_(0),
+      checkpoint_written_(true) {
+  shared_neighbor_[0] = shared_neighbor_[1] = nullptr;
+  for (auto& request : control_requests_) {
+    request = MPI_REQUEST_NULL;
   }
+  census_requests_[0] = census_requests_[1] = MPI_REQUEST_NULL;
 
-  // При плохих входных данных устанавливаем b3/s23.
-  if (rules_.born_.empty() && rules_.stay_.empty()) {
-    rules_.born_.push_back(3);
-    rules_.stay_.push_back(2);
-    rules_.stay_.push_back(3);
-  }
+  rules_ = ParseRules(rules);
 }
 
 bool GameOfLife::Start(const size_t h_size, const size_t v_size) {
@@ -55,6 +113,9 @@ bool GameOfLife::Start(const size_t h_size, const size_t v_size) {
   }
 
   if (world_rank_ == 0) {
+    if (h_size < SlavesMinRows()) {
+      return false;
+    }
     std::mt19937 rng(1337);
     std::bernoulli_distribution bern(0.5);
     for (size_t i = 0; i < h_size; ++i) {
@@ -67,41 +128,68 @@ bool GameOfLife::Start(const size_t h_size, const size_t v_size) {
 
   BroadcastField();
   new_field_ = field_;
+  if (world_rank_ == 0) {
+    CountTiles(field_, population_);
+  } else {
+    census_part_ = CountCensus(field_, borders_[0], borders_.back(),
+                               global_offset_ - borders_[0]);
+    StartCensusReduce();
+  }
 
   return true;
 }
 
-bool GameOfLife::Start(const std::string& filename) {
+bool GameOfLife::Start(const std::string& filename, const size_t h_size,
+                       const size_t v_size) {
   if (!field_.empty()) {
     return false;
   }
 
   if (world_rank_ == 0) {
-    std::ifstream fin(filename);
-    int c = 0;
-    for (size_t i = 0; !fin.eof(); ++i) {
-      for (size_t j = 0; !fin.eof(); ++j) {
-        c = fin.get();
-        if (fin.eof()) {
-          break;
-        }
-        if (c == ',') {
-          continue;
-        }
-        if (c == '\n') {
-          break;
-        }
-
-        if (j == 0) {
-          field_.push_back(CyclicVector<char>());
-        }
-        field_[i].push_back(static_cast<char>(c - '0'));
+    MappedFile file(filename);
+    bool loaded = false;
+    auto rules_before = rules_;
+    size_t iterations_before = iterations_count_;
+    if (IsCheckpointManifest(filename)) {
+      std::string rules;
+      size_t generation = 0;
+      loaded = LoadCheckpoint(filename, field_, rules, generation);
+      if (loaded) {
+        rules_ = ParseRules(rules);
+        iterations_count_ = desired_iterations_count_ = generation;
+      }
+    } else if (IsBinaryBoard(file)) {
+      std::string rules;
+      size_t generation = 0;
+      loaded = LoadBinaryBoard(file, field_, rules, generation);
+      if (loaded) {
+        rules_ = ParseRules(rules);
+        iterations_count_ = desired_iterations_count_ = generation;
       }
+    } else if (IsRleBoard(file)) {
+      std::string rules;
+      loaded = LoadRleBoard(file, field_, rules, h_size, v_size);
+      if (loaded && !rules.empty()) {
+        rules_ = ParseRules(rules);
+      }
+    } else {
+      loaded = LoadCsvBoard(file, field_, std::thread::hardware_concurrency());
+    }
+    // Рабам команда не рассылается, пока поле не прочитано. Правила
+    // Generations считает только gol_pthread.
+    if (!loaded || rules_.states_ > 2 || field_.size() < SlavesMinRows()) {
+      rules_ = rules_before;
+      iterations_count_ = desired_iterations_count_ = iterations_before;
+      field_.clear();
+      return false;
     }
   }
 
   BroadcastField();
   new_field_ = field_;
+  if (world_rank_ == 0) {
+    CountTiles(field_, population_);
+  }
 
   return true;
 }
@@ -112,20 +200,31 @@ bool GameOfLife::Run(const size_t add_iterations) {
   }
 
   if (world_rank_ == 0) { // мастер
-    size_t message = add_iterations;
-    for (int i = 1; i < world_size_; ++i) {
-      MPI_Send(&message, 1, MPI_UNSIGNED_LONG, i, MpiGolTag::Run, mpi_comm_);
-    }
+    SendCommand(static_cast<int>(MpiGolCommand::Run), add_iterations);
     up_to_date_ = false;
   }
-  // Обработка сообщений для раба была сделана заранее.
+  // Команду раб получает в SlaveCommand.
   desired_iterations_count_ += add_iterations;
   running_ = true;
 
   return true;
 }
 
-bool GameOfLife::Stop(const size_t final_iterations_count) {
+bool GameOfLife::Wait() {
+  assert(world_rank_ == 0);
+  if (field_.empty()) {
+    return false;
+  }
+  // Рабы не сообщают об окончании счета сами, поэтому состояние
+  // опрашивается. Опрос не прерывает счет.
+  while (Running()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+bool GameOfLife::Stop() {
+  assert(world_rank_ == 0);
   if (field_.empty()) {
     return false;
   }
@@ -133,38 +232,106 @@ bool GameOfLife::Stop(const size_t final_iterations_count) {
     return true;
   }
 
-  if (world_rank_ == 0) { // мастер
-    char x = 1;
-    for (int i = 1; i < world_size_; ++i) { // Посылаем сигнал об остановке.
-      MPI_Send(&x, 1, MPI_BYTE, i, MpiGolTag::Stop, mpi_comm_);
-    }
-    size_t message;
-    size_t max_iterations_count = 0;
-    for (int i = 1; i < world_size_; ++i) { // Получаем текущее число итераций.
-      MPI_Recv(&message, 1, MPI_UNSIGNED_LONG, i, MpiGolTag::Stop, mpi_comm_,
-          MPI_STATUS_IGNORE);
-      max_iterations_count = std::max(message, max_iterations_count);
-    }
-    ++max_iterations_count;
-    // Посылаем число итераций для доделывания.
-    for (int i = 1; i < world_size_; ++i) {
-      MPI_Send(&max_iterations_count, 1, MPI_UNSIGNED_LONG, i,
-          MpiGolTag::Stop, mpi_comm_);
-    }
-    desired_iterations_count_ = max_iterations_count;
-    for (int i = 1; i < world_size_; ++i) { // Ожидаем завершения работы.
-      MPI_Recv(&x, 1, MPI_BYTE, i, MpiGolTag::Stop, mpi_comm_,
-          MPI_STATUS_IGNORE);
-    }
-  } else {
-    // Обработка сообщений для раба была сделана заранее.
-    desired_iterations_count_ = final_iterations_count;
-  }
+  SendCommand(static_cast<int>(MpiGolCommand::Stop));
+  // Рабы сообщают итерацию, до которой успеют дойти, и останавливаются на
+  // наибольшей из них.
+  unsigned long local_iterations_count = 0;
+  unsigned long max_iterations_count = 0;
+  MPI_Request request;
+  MPI_Iallreduce(&local_iterations_count, &max_iterations_count, 1,
+      MPI_UNSIGNED_LONG, MPI_MAX, control_comm_, &request);
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+  desired_iterations_count_ = max_iterations_count;
+  // Ожидаем завершения работы.
+  MPI_Ibarrier(control_comm_, &request);
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
   running_ = false;
 
   return true;
 }
 
+size_t GameOfLife::Pause() {
+  size_t desired_iterations_count = desired_iterations_count_;
+  Stop();
+  if (desired_iterations_count <= desired_iterations_count_) {
+    return 0;
+  }
+  return desired_iterations_count - desired_iterations_count_;
+}
+
+bool GameOfLife::Checkpoint(const std::string& filename) {
+  assert(world_rank_ == 0);
+  if (field_.empty()) {
+    return false;
+  }
+
+  // Итерация контрольной точки согласуется так же, как при остановке.
+  size_t remaining = Pause();
+  SendCommand(static_cast<int>(MpiGolCommand::Checkpoint));
+  std::string name = filename;
+  BroadcastString(name);
+  std::vector<long long> infos((world_size_ - 1) * kCheckpointInfoSize);
+  for (int i = 1; i < world_size_; ++i) {
+    MPI_Recv(&infos[(i - 1) * kCheckpointInfoSize], kCheckpointInfoSize,
+        MPI_LONG_LONG, i, MpiGolTag::Checkpoint, mpi_comm_, MPI_STATUS_IGNORE);
+  }
+  // Участки уже скопированы, рабы пишут их, продолжая счет.
+  if (remaining > 0) {
+    Run(remaining);
+  }
+  return WriteCheckpointManifest(filename, infos);
+}
+
+void GameOfLife::SetAutoCheckpoint(const std::string& filename,
+                                   const size_t every) {
+  assert(world_rank_ == 0);
+  // Рабы должны начать делать точки с одной и той же итерации.
+  size_t remaining = Pause();
+  SendCommand(static_cast<int>(MpiGolCommand::AutoCheckpoint), every);
+  std::string name = filename;
+  BroadcastString(name);
+  if (remaining > 0) {
+    Run(remaining);
+  }
+}
+
+bool GameOfLife::Edit(const std::vector<CellEdit>& edits) {
+  assert(world_rank_ == 0);
+  if (field_.empty()) {
+    return false;
+  }
+
+  // Участки рабов меняются при балансировке, поэтому правки применяются на
+  // итерации, согласованной так же, как при остановке.
+  size_t remaining = Pause();
+  SendCommand(static_cast<int>(MpiGolCommand::Edit), edits.size());
+  long long height = static_cast<long long>(field_.size());
+  std::vector<long long> data;
+  data.reserve(3 * edits.size());
+  for (const auto& edit : edits) {
+    data.push_back((edit.row_ % height + height) % height);
+    data.push_back(edit.column_);
+    data.push_back(edit.alive_ ? 1 : 0);
+  }
+  MPI_Request request;
+  MPI_Ibcast(data.data(), static_cast<int>(data.size()), MPI_LONG_LONG, 0,
+      control_comm_, &request);
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+  up_to_date_ = false;
+  if (remaining > 0) {
+    Run(remaining);
+  }
+  return true;
+}
+
+bool GameOfLife::Restore(const std::string& filename) {
+  if (!IsCheckpointManifest(filename) &&
+      !IsBinaryBoard(MappedFile(filename))) {
+    return false;
+  }
+  return Start(filename);
+}
+
 bool GameOfLife::Update() {
   if (field_.empty()) {
     return false;
@@ -177,14 +344,24 @@ bool GameOfLife::Update() {
   }
 
   if (world_rank_ == 0) {
-    char x = 1;
-    for (int i = 1; i < world_size_; ++i) { // Посылаем сигнал об обновлении.
-      MPI_Send(&x, 1, MPI_BYTE, i, MpiGolTag::Update, mpi_comm_);
-    }
-    for (int i = 1; i < world_size_; ++i) { // Собираем поле по кусочкам.
-      for (long long j = borders_[i]; j < borders_[i + 1]; ++j) {
-        MPI_Recv(field_[j].data(), static_cast<int>(field_[0].size()),
-            MPI_BYTE, i, MpiGolTag::Update, mpi_comm_, MPI_STATUS_IGNORE);
+    SendCommand(static_cast<int>(MpiGolCommand::Update));
+    for (int i = 1; i < world_size_; ++i) { // Собираем изменения по кусочкам.
+      // Участки могли измениться при балансировке, поэтому сначала узнаем
+      // текущее положение участка и число измененных строк.
+      long long header[3];
+      MPI_Recv(header, 3, MPI_LONG_LONG, i, MpiGolTag::FieldSize, mpi_comm_,
+          MPI_STATUS_IGNORE);
+      borders_[i] = header[0];
+      borders_[i + 1] = header[0] + header[1];
+      if (header[2] == 0) {
+        continue;
+      }
+      std::vector<long long> rows(header[2]);
+      MPI_Recv(rows.data(), static_cast<int>(header[2]), MPI_LONG_LONG, i,
+          MpiGolTag::DirtyRows, mpi_comm_, MPI_STATUS_IGNORE);
+      RecvRows(rows, i, MpiGolTag::Update);
+      for (auto j : rows) {
+        CountTiles(field_[j], population_[j]);
       }
     }
   }
@@ -193,15 +370,21 @@ bool GameOfLife::Update() {
   return true;
 }
 
+bool GameOfLife::Save(const std::string& filename) {
+  assert(world_rank_ == 0);
+  if (!Update()) {
+    return false;
+  }
+  return SaveBinaryBoard(filename, field_, RulesString(rules_),
+                         iterations_count_);
+}
+
 void GameOfLife::Quit() {
   assert(world_rank_ == 0);
   Stop();
   Update();
 
-  char x = 1;
-  for (int i = 1; i < world_size_; ++i) {
-    MPI_Send(&x, 1, MPI_BYTE, i, MpiGolTag::Quit, mpi_comm_);
-  }
+  SendCommand(static_cast<int>(MpiGolCommand::Quit));
 }
 
 void GameOfLife::PrintField(std::ostream& out) {
@@ -211,23 +394,19 @@ void GameOfLife::PrintField(std::ostream& out) {
   }
 
   Update();
-  out << "Field:\n\u2554";
-  for (int i = 0; i < field_[0].size(); ++i) {
-    out << "\u2550";
-  }
-  out << "\u2557\n";
-  for (const auto& line : field_) {
-    out << "\u2551";
-    for (const auto& cell : line) {
-      out << (cell ? "\u2588" : "\u2591");
-    }
-    out << "\u2551\n";
-  }
-  out << "\u255A";
-  for (int i = 0; i < field_[0].size(); ++i) {
-    out << "\u2550";
+  out << "Field:\n"
+      << RenderView(field_, population_, 0, 0, field_[0].size(),
+                    field_.size(), 1);
+}
+
+bool GameOfLife::View(const long long x, const long long y, const size_t w,
+                      const size_t h, const size_t zoom, std::ostream& out) {
+  assert(world_rank_ == 0);
+  if (!Update()) {
+    return false;
   }
-  out << "\u255D\n";
+  out << RenderView(field_, population_, x, y, w, h, zoom);
+  return true;
 }
 
 bool GameOfLife::PrintStatus(std::ostream& out) {
@@ -236,7 +415,8 @@ bool GameOfLife::PrintStatus(std::ostream& out) {
     return false;
   }
   if (Running()) {
-    out << "Running...\n";
+    out << "Running... Currently at " << iterations_count_ << " iteration.\n"
+        << "To show the field calculations should be stopped.\n";
     return false;
   }
 
@@ -245,6 +425,112 @@ bool GameOfLife::PrintStatus(std::ostream& out) {
   return true;
 }
 
+bool GameOfLife::PrintStats(const bool json, std::ostream& out) {
+  assert(world_rank_ == 0);
+  if (field_.empty()) {
+    out << "No field has been created yet.\n";
+    return false;
+  }
+
+  SendCommand(static_cast<int>(MpiGolCommand::Stats), 0);
+  const char* names[] = {"compute", "halo wait", "balance"};
+  const char* json_names[] = {"compute", "halo_wait", "balance"};
+  TimeHistogram total[SlavePhasesCount];
+  std::vector<uint64_t> stats(kStatsSize);
+  std::string ranks;
+  if (json) {
+    out << "{\"ranks\": [";
+  }
+  for (int i = 1; i < world_size_; ++i) {
+    MPI_Recv(stats.data(), kStatsSize, MPI_UINT64_T, i, MpiGolTag::Stats,
+        mpi_comm_, MPI_STATUS_IGNORE);
+    TimeHistogram phases[SlavePhasesCount];
+    for (int phase = 0; phase < SlavePhasesCount; ++phase) {
+      phases[phase].Load(stats.data() + 2 + phase * TimeHistogram::kSavedSize);
+      total[phase].Merge(phases[phase]);
+    }
+
+    if (json) {
+      out << (i == 1 ? "\n  " : ",\n  ") << "{\"rank\": " << i;
+      for (int phase = 0; phase < SlavePhasesCount; ++phase) {
+        out << ", \"" << json_names[phase] << "\": ";
+        phases[phase].PrintJson(out);
+      }
+      out << ", \"halo_bytes_sent\": " << stats[0]
+          << ", \"halo_bytes_received\": " << stats[1] << "}";
+    } else {
+      ranks += "\t" + std::to_string(i) + ": " +
+               std::to_string(phases[Compute].TotalNanoseconds() / 1000000) +
+               " / " +
+               std::to_string(phases[HaloWait].TotalNanoseconds() / 1000000) +
+               " / " + std::to_string(stats[0]) + " / " +
+               std::to_string(stats[1]) + "\n";
+    }
+  }
+  if (json) {
+    out << "]}\n";
+    return true;
+  }
+
+  out << "Slaves: " << world_size_ - 1 << ".\n";
+  TimeHistogram::PrintHeader(out);
+  for (int phase = 0; phase < SlavePhasesCount; ++phase) {
+    total[phase].PrintRow(out, names[phase]);
+  }
+  out << "Per rank (compute ms / halo wait ms / halo bytes sent / "
+         "received):\n" << ranks;
+  return true;
+}
+
+bool GameOfLife::PrintCensus(const size_t count, std::ostream& out) {
+  assert(world_rank_ == 0);
+  if (field_.empty()) {
+    out << "No field has been created yet.\n";
+    return false;
+  }
+
+  SendCommand(static_cast<int>(MpiGolCommand::Census), count);
+  MPI_Status status;
+  MPI_Probe(1, MpiGolTag::CensusSeries, mpi_comm_, &status);
+  int size = 0;
+  MPI_Get_count(&status, MPI_LONG_LONG, &size);
+  std::vector<long long> data(size);
+  MPI_Recv(data.data(), size, MPI_LONG_LONG, 1, MpiGolTag::CensusSeries,
+      mpi_comm_, MPI_STATUS_IGNORE);
+  CensusLog log;
+  for (size_t i = 0; i + Census::kSavedSize <= data.size();
+       i += Census::kSavedSize) {
+    Census census;
+    census.Load(&data[i]);
+    log.Add(census);
+  }
+  log.Print(out, count);
+  return true;
+}
+
+bool GameOfLife::RecordCensus(const std::string& filename) {
+  assert(world_rank_ == 0);
+  if (field_.empty()) {
+    return false;
+  }
+  SendCommand(static_cast<int>(MpiGolCommand::CensusRecord));
+  std::string name = filename;
+  BroadcastString(name);
+  int recording = 0;
+  MPI_Recv(&recording, 1, MPI_INT, 1, MpiGolTag::CensusSeries, mpi_comm_,
+      MPI_STATUS_IGNORE);
+  return recording != 0;
+}
+
+bool GameOfLife::ResetStats() {
+  assert(world_rank_ == 0);
+  if (field_.empty()) {
+    return false;
+  }
+  SendCommand(static_cast<int>(MpiGolCommand::Stats), 1);
+  return true;
+}
+
 void GameOfLife::SetMpiCommunicator(const MPI_Comm& mpi_comm) {
   mpi_comm_ = mpi_comm;
   int world_size;
@@ -253,164 +539,821 @@ void GameOfLife::SetMpiCommunicator(const MPI_Comm& mpi_comm) {
   int world_rank;
   MPI_Comm_rank(mpi_comm_, &world_rank);
   world_rank_ = world_rank;
+  MPI_Comm_split(mpi_comm_, world_rank_ == 0 ? MPI_UNDEFINED : 1, world_rank_,
+      &slaves_comm_);
+  MPI_Comm_dup(mpi_comm_, &control_comm_);
+  if (slaves_comm_ != MPI_COMM_NULL) {
+    MPI_Comm_split_type(slaves_comm_, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL,
+        &node_comm_);
+  }
+  // Единственный раб обменивается границами сам с собой, окна ему не нужны.
+  if (world_size_ < 3) {
+    halo_mode_ = HaloMode::TwoSided;
+  }
+}
+
+void GameOfLife::SendCommand(const int command,
+                             const unsigned long argument) {
+  assert(world_rank_ == 0);
+  // Рабы ожидают команды неблокирующим MPI_Ibcast, а блокирующие и
+  // неблокирующие коллективные операции не сопоставляются друг с другом.
+  unsigned long message[2] = {static_cast<unsigned long>(command), argument};
+  MPI_Request request;
+  MPI_Ibcast(message, 2, MPI_UNSIGNED_LONG, 0, control_comm_, &request);
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+}
+
+void GameOfLife::BroadcastString(std::string& str) {
+  unsigned long length = str.size();
+  MPI_Request request;
+  MPI_Ibcast(&length, 1, MPI_UNSIGNED_LONG, 0, control_comm_, &request);
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+  str.resize(length);
+  MPI_Ibcast(&str[0], static_cast<int>(length), MPI_CHAR, 0, control_comm_,
+      &request);
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
 }
 
 void GameOfLife::SlaveSynchronize() {
   assert(world_rank_ != 0);
-  char x = 1;
-  MPI_Status status;
-  MPI_Recv(&x, 1, MPI_BYTE, 0, MPI_ANY_TAG, mpi_comm_, &status);
-  if (status.MPI_TAG == MpiGolTag::Quit) {
-    return;
-  }
-  assert(status.MPI_TAG == MpiGolTag::Start);
-  Start();
+  MPI_Ibcast(control_message_, 2, MPI_UNSIGNED_LONG, 0, control_comm_,
+      &control_requests_[kCommandRequest]);
 
   bool quit = false;
-  bool notify_master = false;
-  bool turn = static_cast<bool>(world_rank_ % 2); // Для предотвращения дедлока.
-  // Флажки актуальности правой и левой границы.
-  bool border_gained[2] = {false, false};
-
   while (!quit) {
-    if (running_ && iterations_count_ < desired_iterations_count_) {
-      if (turn) {
-        MPI_Send(field_[borders_[0]].data(), static_cast<int>(field_[0].size()),
-            MPI_BYTE, process_[world_rank_ - 2], MpiGolTag::Run, mpi_comm_);
-        MPI_Send(field_[borders_.back() - 1].data(), static_cast<int>(field_[0].size()),
-            MPI_BYTE, process_[world_rank_], MpiGolTag::Run, mpi_comm_);
-        while (!(border_gained[0] && border_gained[1])) {
-          SlaveRecv(border_gained, quit, notify_master);
-        }
-      } else {
-        while (!(border_gained[0] && border_gained[1])) {
-          SlaveRecv(border_gained, quit, notify_master);
-        }
-        MPI_Send(field_[borders_[0]].data(), static_cast<int>(field_[0].size()),
-            MPI_BYTE, process_[world_rank_ - 2], MpiGolTag::Run, mpi_comm_);
-        MPI_Send(field_[borders_.back() - 1].data(), static_cast<int>(field_[0].size()),
-            MPI_BYTE, process_[world_rank_], MpiGolTag::Run, mpi_comm_);
-      }
+    if (stop_state_ == StopState::Finishing &&
+        iterations_count_ >= desired_iterations_count_) {
+      SlaveFinishStop();
+    }
+
+    if (running_ && iterations_count_ < desired_iterations_count_ &&
+        stop_state_ != StopState::Reducing) {
+      ExchangeBorders(quit);
 
+      auto calculation_start = std::chrono::steady_clock::now();
       CalculatePart();
+      calculation_time_ += std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - calculation_start).count();
+      phases_[Compute].AddSince(calculation_start);
       field_.swap(new_field_);
       ++iterations_count_;
-      border_gained[0] = border_gained[1] = false;
+      StartCensusReduce();
+      // Балансировка происходит на одних и тех же итерациях у всех рабов.
+      if (iterations_count_ % kBalancePeriod == 0) {
+        auto balance_start = TimeHistogram::Clock::now();
+        BalanceLoad(quit);
+        phases_[Balance].AddSince(balance_start);
+      }
+      if (auto_checkpoint_every_ != 0 &&
+          iterations_count_ % auto_checkpoint_every_ == 0) {
+        SlaveAutoCheckpoint(quit);
+      }
       if (iterations_count_ >= desired_iterations_count_) {
         running_ = false;
-        if (notify_master) {
-          MPI_Send(&x, 1, MPI_BYTE, 0, MpiGolTag::Stop, mpi_comm_);
-          notify_master = false;
-        }
+        FinishCensusReduce(true);
       }
+      // Команды мастера проверяются между итерациями.
+      SlaveControl(false, false, quit);
     } else {
-      SlaveRecv(border_gained, quit, notify_master);
+      SlaveControl(true, false, quit);
     }
   }
 }
 
-void GameOfLife::SlaveRecv(bool* border_gained, bool& quit,
-                           bool& notify_master) {
-  MPI_Status status;
-  MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, mpi_comm_, &status);
-  if (status.MPI_SOURCE == 0) {
-    if (status.MPI_TAG == MpiGolTag::Running) {
-      char x = 1;
-      MPI_Recv(&x, 1, MPI_BYTE, 0, MpiGolTag::Running, mpi_comm_,
+void GameOfLife::SlaveControl(const bool blocking, const bool mid_generation,
+                              bool& quit) {
+  while (!quit) {
+    int index = MPI_UNDEFINED;
+    int completed = 0;
+    if (blocking) {
+      MPI_Waitany(3, control_requests_, &index, MPI_STATUS_IGNORE);
+    } else {
+      MPI_Testany(3, control_requests_, &index, &completed,
           MPI_STATUS_IGNORE);
-      MPI_Send(&running_, 1, MPI_CXX_BOOL, 0, MpiGolTag::Running, mpi_comm_);
+    }
+    if (index == MPI_UNDEFINED) {
+      return;
+    }
 
-    } else if (status.MPI_TAG == MpiGolTag::Run) {
-      size_t add_iterations;
-      MPI_Recv(&add_iterations, 1, MPI_UNSIGNED_LONG, 0, MpiGolTag::Run,
-          mpi_comm_, MPI_STATUS_IGNORE);
-      Run(add_iterations);
+    if (index == kCommandRequest) {
+      SlaveCommand(mid_generation, quit);
+    } else if (index == kReduceRequest &&
+               stop_state_ == StopState::Reducing) {
+      desired_iterations_count_ = reduce_result_[0];
+      stop_state_ = StopState::Finishing;
+    }
+    if (blocking) {
+      return;
+    }
+  }
+}
 
-    } else if (status.MPI_TAG == MpiGolTag::Stop) {
-      char x = 1;
-      MPI_Recv(&x, 1, MPI_BYTE, 0, MpiGolTag::Stop, mpi_comm_,
-          MPI_STATUS_IGNORE);
-      MPI_Send(&iterations_count_, 1, MPI_UNSIGNED_LONG, 0, MpiGolTag::Stop,
+void GameOfLife::SlaveCommand(const bool mid_generation, bool& quit) {
+  auto command = static_cast<MpiGolCommand>(control_message_[0]);
+  bool listen = true; // Ожидать ли следующую команду сразу.
+
+  if (command == MpiGolCommand::Start) {
+    Start();
+    if (halo_mode_ == HaloMode::Rma) {
+      CreateHaloWindows();
+    }
+    if (shared_memory_) {
+      CreateSharedWindow();
+    }
+
+  } else if (command == MpiGolCommand::Run) {
+    Run(control_message_[1]);
+
+  } else if (command == MpiGolCommand::Running) {
+    // Предыдущая редукция уже завершена у мастера, а значит и у всех рабов.
+    MPI_Wait(&control_requests_[kReduceRequest], MPI_STATUS_IGNORE);
+    reduce_send_[0] = running_;
+    reduce_send_[1] = iterations_count_;
+    MPI_Iallreduce(reduce_send_, reduce_result_, 2, MPI_UNSIGNED_LONG, MPI_MAX,
+        control_comm_, &control_requests_[kReduceRequest]);
+
+  } else if (command == MpiGolCommand::Stop) {
+    // Посреди итерации раб обязательно ее досчитает.
+    MPI_Wait(&control_requests_[kReduceRequest], MPI_STATUS_IGNORE);
+    reduce_send_[0] = iterations_count_ + (mid_generation ? 1 : 0);
+    MPI_Iallreduce(reduce_send_, reduce_result_, 1, MPI_UNSIGNED_LONG, MPI_MAX,
+        control_comm_, &control_requests_[kReduceRequest]);
+    stop_state_ = StopState::Reducing;
+    // Следующая команда будет ожидаться после барьера в SlaveFinishStop.
+    listen = false;
+
+  } else if (command == MpiGolCommand::Update) {
+    SlaveSendPart();
+
+  } else if (command == MpiGolCommand::Checkpoint) {
+    std::string filename;
+    BroadcastString(filename);
+    std::vector<long long> info;
+    SlaveCheckpoint(filename, info);
+    MPI_Send(info.data(), kCheckpointInfoSize, MPI_LONG_LONG, 0,
+        MpiGolTag::Checkpoint, mpi_comm_);
+
+  } else if (command == MpiGolCommand::AutoCheckpoint) {
+    BroadcastString(auto_checkpoint_file_);
+    auto_checkpoint_every_ = control_message_[1];
+
+  } else if (command == MpiGolCommand::Stats) {
+    if (control_message_[1] == 0) {
+      std::vector<uint64_t> stats = {halo_bytes_sent_, halo_bytes_received_};
+      for (const auto& phase : phases_) {
+        phase.Save(stats);
+      }
+      MPI_Send(stats.data(), kStatsSize, MPI_UINT64_T, 0, MpiGolTag::Stats,
           mpi_comm_);
-      MPI_Recv(&desired_iterations_count_, 1, MPI_UNSIGNED_LONG, 0,
-          MpiGolTag::Stop, mpi_comm_, MPI_STATUS_IGNORE);
-      notify_master = true;
+    } else {
+      for (auto& phase : phases_) {
+        phase.Reset();
+      }
+      halo_bytes_sent_ = halo_bytes_received_ = 0;
+    }
 
-    } else if (status.MPI_TAG == MpiGolTag::Update) {
-      char x = 1;
-      MPI_Recv(&x, 1, MPI_BYTE, 0, MpiGolTag::Update, mpi_comm_,
-          MPI_STATUS_IGNORE);
-      for (long long j = borders_[0]; j < borders_.back(); ++j) {
-        MPI_Send(field_[j].data(), static_cast<int>(field_[0].size()),
-            MPI_BYTE, 0, MpiGolTag::Update, mpi_comm_);
+  } else if (command == MpiGolCommand::Census) {
+    // Посреди счета ждать редукцию нельзя: ее участники могут ждать этого
+    // раба в обмене границами.
+    FinishCensusReduce(false);
+    if (world_rank_ == 1) {
+      std::vector<long long> data;
+      census_.Save(control_message_[1], data);
+      MPI_Send(data.data(), static_cast<int>(data.size()), MPI_LONG_LONG, 0,
+          MpiGolTag::CensusSeries, mpi_comm_);
+    }
+
+  } else if (command == MpiGolCommand::CensusRecord) {
+    std::string filename;
+    BroadcastString(filename);
+    if (world_rank_ == 1) {
+      int recording = 1;
+      if (filename.empty()) {
+        census_.StopRecording();
+      } else {
+        recording = census_.Record(filename) ? 1 : 0;
       }
+      MPI_Send(&recording, 1, MPI_INT, 0, MpiGolTag::CensusSeries,
+          mpi_comm_);
+    }
 
-    } else if (status.MPI_TAG == MpiGolTag::Quit) {
-      char x = 1;
-      MPI_Recv(&x, 1, MPI_BYTE, 0, MpiGolTag::Quit, mpi_comm_,
-          MPI_STATUS_IGNORE);
-      quit = true;
+  } else if (command == MpiGolCommand::Edit) {
+    std::vector<long long> edits(3 * control_message_[1]);
+    MPI_Request request;
+    MPI_Ibcast(edits.data(), static_cast<int>(edits.size()), MPI_LONG_LONG, 0,
+        control_comm_, &request);
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+    SlaveApplyEdits(edits);
+
+  } else if (command == MpiGolCommand::Quit) {
+    FinishCensusReduce(true);
+    census_.StopRecording();
+    FinishCheckpointWrite();
+    FreeHaloWindows();
+    FreeSharedWindow();
+    quit = true;
+    listen = false;
+  }
+
+  if (listen) {
+    MPI_Ibcast(control_message_, 2, MPI_UNSIGNED_LONG, 0, control_comm_,
+        &control_requests_[kCommandRequest]);
+  }
+}
+
+void GameOfLife::SlaveApplyEdits(const std::vector<long long>& edits) {
+  // Теневые строки обновятся при обмене границами в начале итерации.
+  for (size_t k = 0; k < edits.size(); k += 3) {
+    long long row = edits[k] - global_offset_ + borders_[0];
+    if (row < borders_[0] || row >= borders_.back()) {
+      continue;
     }
+    field_[row][edits[k + 1]] = static_cast<char>(edits[k + 2]);
+    dirty_rows_[row] = 1;
+  }
+}
 
-  } else {
-    assert(status.MPI_TAG == MpiGolTag::Run);
-    if (status.MPI_SOURCE == process_[world_rank_]) { // правая граница
-      MPI_Recv(field_[borders_.back()].data(),
-          static_cast<int>(field_[0].size()), MPI_BYTE, status.MPI_SOURCE,
-          MpiGolTag::Run, mpi_comm_, MPI_STATUS_IGNORE);
-      border_gained[1] = true;
-    } else if (status.MPI_SOURCE == process_[world_rank_ - 2]) {// левая граница
-      MPI_Recv(field_[borders_[0] - 1].data(),
-          static_cast<int>(field_[0].size()), MPI_BYTE, status.MPI_SOURCE,
-          MpiGolTag::Run, mpi_comm_, MPI_STATUS_IGNORE);
-      border_gained[0] = true;
+void GameOfLife::SlaveFinishStop() {
+  running_ = false;
+  FinishCensusReduce(true);
+  stop_state_ = StopState::None;
+  MPI_Wait(&control_requests_[kBarrierRequest], MPI_STATUS_IGNORE);
+  MPI_Ibarrier(control_comm_, &control_requests_[kBarrierRequest]);
+  MPI_Ibcast(control_message_, 2, MPI_UNSIGNED_LONG, 0, control_comm_,
+      &control_requests_[kCommandRequest]);
+}
+
+void GameOfLife::SlaveSendPart() {
+  // Мастер уже знает строки, не изменившиеся с прошлого сбора.
+  std::vector<long long> local_rows;
+  std::vector<long long> global_rows;
+  for (long long j = borders_[0]; j < borders_.back(); ++j) {
+    if (dirty_rows_[j]) {
+      local_rows.push_back(j);
+      global_rows.push_back(global_offset_ + j - borders_[0]);
+      dirty_rows_[j] = 0;
     }
   }
+
+  long long header[3] = {global_offset_, borders_.back() - borders_[0],
+                         static_cast<long long>(local_rows.size())};
+  MPI_Send(header, 3, MPI_LONG_LONG, 0, MpiGolTag::FieldSize, mpi_comm_);
+  if (local_rows.empty()) {
+    return;
+  }
+  MPI_Send(global_rows.data(), static_cast<int>(global_rows.size()),
+      MPI_LONG_LONG, 0, MpiGolTag::DirtyRows, mpi_comm_);
+  SendRows(local_rows, 0, MpiGolTag::Update);
 }
 
-void GameOfLife::CalculatePart() {
-  for (long long i = borders_[0]; i < borders_.back(); ++i) {
-    for (long long j = 0; j < field_[i].size(); ++j) {
-      char num_alive = 0;
-      for (int x = -1; x <= 1; ++x) {
-        for (int y = -1; y <= 1; ++y) {
-          if (x != 0 || y != 0) {
-            num_alive += field_[i + x][j + y];
-          }
-        }
+void GameOfLife::SendRows(const std::vector<long long>& rows, const int dest,
+                          const int tag) {
+  std::vector<unsigned char> message;
+  message.reserve(rows.size() * MaxEncodedRowSize(field_[0].size()));
+  for (auto j : rows) {
+    EncodeRow(field_[j].data(), field_[j].size(), sparse_rows_, message);
+  }
+  MPI_Send(message.data(), static_cast<int>(message.size()), MPI_BYTE, dest,
+      tag, mpi_comm_);
+}
+
+void GameOfLife::RecvRows(const std::vector<long long>& rows, const int source,
+                          const int tag) {
+  MPI_Status status;
+  MPI_Probe(source, tag, mpi_comm_, &status);
+  int size = 0;
+  MPI_Get_count(&status, MPI_BYTE, &size);
+  std::vector<unsigned char> message(size);
+  MPI_Recv(message.data(), size, MPI_BYTE, source, tag, mpi_comm_,
+      MPI_STATUS_IGNORE);
+  const unsigned char* data = message.data();
+  for (auto j : rows) {
+    data = DecodeRow(data, field_[j].size(), field_[j].data());
+  }
+}
+
+void GameOfLife::ExchangeBorders(bool& quit) {
+  int width = static_cast<int>(field_[0].size());
+  long long depth = rules_.radius_;
+  int slot_size = static_cast<int>(depth * MaxEncodedRowSize(width));
+  // Для каждой стороны: сосед, первая из отдаваемых ему строк, первая
+  // теневая строка и теги обмена.
+  int neighbor[2] = {process_[world_rank_ - 2], process_[world_rank_]};
+  long long outgoing[2] = {borders_[0], borders_.back() - depth};
+  long long ghost[2] = {borders_[0] - depth, borders_.back()};
+  int send_tag[2] = {MpiGolTag::HaloUp, MpiGolTag::HaloDown};
+  int recv_tag[2] = {MpiGolTag::HaloDown, MpiGolTag::HaloUp};
+  int parity = static_cast<int>(iterations_count_ % 2);
+  unsigned long flag = iterations_count_ + 1;
+
+  if (shared_neighbor_[0] != nullptr || shared_neighbor_[1] != nullptr) {
+    PublishSharedBorders(parity, flag);
+  }
+
+  // Обмен идет с конкретными соседями по разным тегам, поэтому строки разных
+  // итераций и разных сторон не путаются, даже если оба соседа - один процесс.
+  std::vector<MPI_Request> requests;
+  for (int side = 0; side < 2; ++side) {
+    if (shared_neighbor_[side] != nullptr) {
+      continue;
+    }
+    halo_out_[side].clear();
+    for (long long i = 0; i < depth; ++i) {
+      EncodeRow(field_[outgoing[side] + i].data(), width, sparse_rows_,
+          halo_out_[side]);
+    }
+    int size = static_cast<int>(halo_out_[side].size());
+    halo_bytes_sent_ += size;
+    if (halo_mode_ == HaloMode::Rma) {
+      // Строка попадает в противоположное место окна соседа.
+      MPI_Aint slot = 2 * parity + 1 - side;
+      MPI_Put(halo_out_[side].data(), size, MPI_BYTE, neighbor[side] - 1,
+          slot * slot_size, size, MPI_BYTE, halo_window_);
+      MPI_Win_flush(neighbor[side] - 1, halo_window_);
+      // Флажок ставится только после того, как строка гарантированно записана.
+      MPI_Accumulate(&flag, 1, MPI_UNSIGNED_LONG, neighbor[side] - 1, slot, 1,
+          MPI_UNSIGNED_LONG, MPI_REPLACE, halo_flags_window_);
+      MPI_Win_flush(neighbor[side] - 1, halo_flags_window_);
+    } else {
+      halo_in_[side].resize(slot_size);
+      requests.emplace_back();
+      MPI_Irecv(halo_in_[side].data(), slot_size, MPI_BYTE, neighbor[side],
+          recv_tag[side], mpi_comm_, &requests.back());
+      requests.emplace_back();
+      MPI_Isend(halo_out_[side].data(), size, MPI_BYTE, neighbor[side],
+          send_tag[side], mpi_comm_, &requests.back());
+    }
+  }
+
+  // Ждем строки соседей, продолжая обрабатывать команды мастера.
+  auto wait_start = TimeHistogram::Clock::now();
+  bool arrived[2] = {false, false};
+  int done = 0;
+  while (true) {
+    MPI_Testall(static_cast<int>(requests.size()), requests.data(), &done,
+        MPI_STATUSES_IGNORE);
+    for (int side = 0; side < 2; ++side) {
+      if (!arrived[side]) {
+        arrived[side] = BorderArrived(side, parity, flag);
       }
+    }
+    if (done && arrived[0] && arrived[1]) {
+      break;
+    }
+    SlaveControl(false, true, quit);
+  }
+  phases_[HaloWait].AddSince(wait_start);
 
-      if (field_[i][j]) {
-        new_field_[i][j] = 0;
-        for (auto num_to_stay : rules_.stay_) {
-          if (num_alive == num_to_stay) {
-            new_field_[i][j] = 1;
-            break;
-          }
-        }
-      } else {
-        new_field_[i][j] = 0;
-        for (auto num_to_be_born : rules_.born_) {
-          if (num_alive == num_to_be_born) {
-            new_field_[i][j] = 1;
-            break;
-          }
+  if (halo_mode_ == HaloMode::TwoSided) {
+    for (int side = 0; side < 2; ++side) {
+      if (shared_neighbor_[side] == nullptr) {
+        const unsigned char* end = halo_in_[side].data();
+        for (long long i = 0; i < depth; ++i) {
+          end = DecodeRow(end, width, field_[ghost[side] + i].data());
         }
+        halo_bytes_received_ += end - halo_in_[side].data();
       }
     }
   }
 }
 
+bool GameOfLife::BorderArrived(const int side, const int parity,
+                               const unsigned long flag) {
+  long long width = static_cast<long long>(field_[0].size());
+  long long depth = rules_.radius_;
+  long long ghost = side == 0 ? borders_[0] - depth : borders_.back();
+
+  if (shared_neighbor_[side] != nullptr) {
+    // Предыдущий сосед отдает свои последние строки, следующий - первые.
+    auto published = reinterpret_cast<volatile unsigned long*>(
+        shared_neighbor_[side]);
+    if (published[parity] != flag) {
+      return false;
+    }
+    MPI_Win_sync(shared_window_);
+    const char* rows = shared_neighbor_[side] + kSharedHeaderSize +
+                       (2 * parity + 1 - side) * depth * width;
+    for (long long i = 0; i < depth; ++i) {
+      std::copy(rows + i * width, rows + (i + 1) * width,
+                field_[ghost + i].data());
+    }
+    halo_bytes_received_ += depth * width;
+    return true;
+  }
+
+  if (halo_mode_ == HaloMode::Rma) {
+    int rank = world_rank_ - 1;
+    long long slot_size =
+        depth * static_cast<long long>(MaxEncodedRowSize(width));
+    MPI_Aint slot = 2 * parity + side;
+    unsigned long current_flag = 0;
+    MPI_Fetch_and_op(nullptr, &current_flag, MPI_UNSIGNED_LONG, rank, slot,
+        MPI_NO_OP, halo_flags_window_);
+    MPI_Win_flush(rank, halo_flags_window_);
+    if (current_flag != flag) {
+      return false;
+    }
+    MPI_Win_sync(halo_window_);
+    const unsigned char* begin = halo_buffer_.data() + slot * slot_size;
+    const unsigned char* end = begin;
+    for (long long i = 0; i < depth; ++i) {
+      end = DecodeRow(end, width, field_[ghost + i].data());
+    }
+    halo_bytes_received_ += end - begin;
+    return true;
+  }
+
+  // При двустороннем обмене строка раскодируется после приема.
+  return true;
+}
+
+void GameOfLife::PublishSharedBorders(const int parity,
+                                      const unsigned long flag) {
+  long long width = static_cast<long long>(field_[0].size());
+  long long depth = rules_.radius_;
+  char* rows = shared_segment_ + kSharedHeaderSize + 2 * parity * depth * width;
+  for (long long i = 0; i < depth; ++i) {
+    const auto& first = field_[borders_[0] + i];
+    const auto& last = field_[borders_.back() - depth + i];
+    std::copy(first.begin(), first.end(), rows + i * width);
+    std::copy(last.begin(), last.end(), rows + (depth + i) * width);
+  }
+  halo_bytes_sent_ += 2 * depth * width;
+  // Номер итерации становится виден соседям только после самих строк.
+  MPI_Win_sync(shared_window_);
+  reinterpret_cast<volatile unsigned long*>(shared_segment_)[parity] = flag;
+}
+
+void GameOfLife::CreateHaloWindows() {
+  size_t slot_size = rules_.radius_ * MaxEncodedRowSize(field_[0].size());
+  halo_buffer_.assign(4 * slot_size, 0);
+  halo_flags_.assign(4, 0);
+  MPI_Win_create(halo_buffer_.data(), static_cast<MPI_Aint>(4 * slot_size),
+      1, MPI_INFO_NULL, slaves_comm_, &halo_window_);
+  MPI_Win_create(halo_flags_.data(),
+      static_cast<MPI_Aint>(4 * sizeof(unsigned long)), sizeof(unsigned long),
+      MPI_INFO_NULL, slaves_comm_, &halo_flags_window_);
+  // Пассивная синхронизация: окна открыты на все время работы.
+  MPI_Win_lock_all(0, halo_window_);
+  MPI_Win_lock_all(0, halo_flags_window_);
+}
+
+void GameOfLife::FreeHaloWindows() {
+  if (halo_window_ == MPI_WIN_NULL) {
+    return;
+  }
+  MPI_Win_unlock_all(halo_window_);
+  MPI_Win_unlock_all(halo_flags_window_);
+  MPI_Win_free(&halo_window_);
+  MPI_Win_free(&halo_flags_window_);
+}
+
+void GameOfLife::CreateSharedWindow() {
+  long long width = static_cast<long long>(field_[0].size());
+  MPI_Win_allocate_shared(
+      static_cast<MPI_Aint>(kSharedHeaderSize + 4 * rules_.radius_ * width), 1,
+      MPI_INFO_NULL,
+      node_comm_, &shared_segment_, &shared_window_);
+  std::fill(shared_segment_, shared_segment_ + kSharedHeaderSize, 0);
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, shared_window_);
+  MPI_Win_sync(shared_window_);
+  MPI_Barrier(node_comm_);
+
+  // Ищем соседей среди рабов узла.
+  MPI_Group slaves_group;
+  MPI_Group node_group;
+  MPI_Comm_group(slaves_comm_, &slaves_group);
+  MPI_Comm_group(node_comm_, &node_group);
+  int neighbor[2] = {process_[world_rank_ - 2] - 1, process_[world_rank_] - 1};
+  for (int side = 0; side < 2; ++side) {
+    int node_rank = MPI_UNDEFINED;
+    MPI_Group_translate_ranks(slaves_group, 1, &neighbor[side], node_group,
+        &node_rank);
+    if (node_rank == MPI_UNDEFINED) {
+      continue;
+    }
+    MPI_Aint size;
+    int disp_unit;
+    MPI_Win_shared_query(shared_window_, node_rank, &size, &disp_unit,
+        &shared_neighbor_[side]);
+  }
+  MPI_Group_free(&slaves_group);
+  MPI_Group_free(&node_group);
+}
+
+void GameOfLife::FreeSharedWindow() {
+  if (shared_window_ == MPI_WIN_NULL) {
+    return;
+  }
+  MPI_Win_unlock_all(shared_window_);
+  MPI_Win_free(&shared_window_);
+  shared_segment_ = nullptr;
+  shared_neighbor_[0] = shared_neighbor_[1] = nullptr;
+}
+
+void GameOfLife::SlaveWait(std::vector<MPI_Request>& requests,
+                           const bool mid_generation, bool& quit) {
+  int done = 0;
+  while (true) {
+    MPI_Testall(static_cast<int>(requests.size()), requests.data(), &done,
+        MPI_STATUSES_IGNORE);
+    if (done) {
+      break;
+    }
+    SlaveControl(false, mid_generation, quit);
+  }
+}
+
+void GameOfLife::BalanceLoad(bool& quit) {
+  int slaves_count = world_size_ - 1;
+  if (slaves_count < 2) {
+    calculation_time_ = 0;
+    return;
+  }
+
+  // Обмениваемся числом строк и временем счета за последний период.
+  double local_load[2] = {static_cast<double>(borders_.back() - borders_[0]),
+                          calculation_time_};
+  std::vector<double> loads(2 * slaves_count);
+  std::vector<MPI_Request> requests(1);
+  MPI_Iallgather(local_load, 2, MPI_DOUBLE, loads.data(), 2, MPI_DOUBLE,
+      slaves_comm_, &requests[0]);
+  SlaveWait(requests, false, quit);
+  calculation_time_ = 0;
+
+  // Границы участков в глобальной нумерации строк.
+  std::vector<long long> old_borders(1, 0);
+  double max_time = 0;
+  double total_time = 0;
+  double total_speed = 0;
+  for (int i = 0; i < slaves_count; ++i) {
+    old_borders.push_back(old_borders.back() +
+                          static_cast<long long>(loads[2 * i]));
+    max_time = std::max(max_time, loads[2 * i + 1]);
+    total_time += loads[2 * i + 1];
+    if (loads[2 * i + 1] <= 0) {
+      return;
+    }
+    total_speed += loads[2 * i] / loads[2 * i + 1];
+  }
+  if (max_time <= kBalanceThreshold * total_time / slaves_count) {
+    return;
+  }
+
+  // Число строк пропорционально скорости раба. Граница сдвигается не более
+  // чем на половину соседних участков сверх радиуса правил, чтобы строки
+  // переходили только между соседями и у каждого участка оставалось не
+  // меньше строк, чем нужно соседям для теневых.
+  long long depth = rules_.radius_;
+  std::vector<long long> new_borders(old_borders);
+  double accumulated_speed = 0;
+  for (int i = 0; i + 1 < slaves_count; ++i) {
+    accumulated_speed += loads[2 * i] / loads[2 * i + 1];
+    long long target = std::llround(static_cast<double>(old_borders.back()) *
+                                    accumulated_speed / total_speed);
+    long long left_rows = old_borders[i + 1] - old_borders[i];
+    long long right_rows = old_borders[i + 2] - old_borders[i + 1];
+    target = std::max(target, old_borders[i + 1] - (left_rows - depth) / 2);
+    target = std::min(target, old_borders[i + 1] + (right_rows - depth) / 2);
+    new_borders[i + 1] = target;
+  }
+
+  int index = world_rank_ - 1;
+  long long width = static_cast<long long>(field_[0].size());
+  long long rows = borders_.back() - borders_[0];
+  long long left_shift = new_borders[index] - old_borders[index];
+  long long right_shift = new_borders[index + 1] - old_borders[index + 1];
+
+  // Отдаваемые строки копируются в буферы, получаемые - принимаются в буферы.
+  std::vector<char> left_out;
+  std::vector<char> right_out;
+  std::vector<char> left_in;
+  std::vector<char> right_in;
+  requests.clear();
+  if (left_shift > 0) {
+    for (long long j = borders_[0]; j < borders_[0] + left_shift; ++j) {
+      left_out.insert(left_out.end(), field_[j].begin(), field_[j].end());
+    }
+    requests.emplace_back();
+    MPI_Isend(left_out.data(), static_cast<int>(left_out.size()), MPI_BYTE,
+        index - 1, MpiGolTag::Balance, slaves_comm_, &requests.back());
+  } else if (left_shift < 0) {
+    left_in.resize(-left_shift * width);
+    requests.emplace_back();
+    MPI_Irecv(left_in.data(), static_cast<int>(left_in.size()), MPI_BYTE,
+        index - 1, MpiGolTag::Balance, slaves_comm_, &requests.back());
+  }
+  if (right_shift < 0) {
+    for (long long j = borders_.back() + right_shift; j < borders_.back();
+         ++j) {
+      right_out.insert(right_out.end(), field_[j].begin(), field_[j].end());
+    }
+    requests.emplace_back();
+    MPI_Isend(right_out.data(), static_cast<int>(right_out.size()), MPI_BYTE,
+        index + 1, MpiGolTag::Balance, slaves_comm_, &requests.back());
+  } else if (right_shift > 0) {
+    right_in.resize(right_shift * width);
+    requests.emplace_back();
+    MPI_Irecv(right_in.data(), static_cast<int>(right_in.size()), MPI_BYTE,
+        index + 1, MpiGolTag::Balance, slaves_comm_, &requests.back());
+  }
+  SlaveWait(requests, false, quit);
+
+  // Перестраиваем участок: теневые строки остаются на месте и будут
+  // обновлены при следующем обмене границами.
+  // Пришедшие строки могли измениться с прошлого сбора у соседа, поэтому
+  // считаются измененными.
+  if (right_shift < 0) {
+    field_.erase(field_.begin() + borders_.back() + right_shift,
+                 field_.begin() + borders_.back());
+    dirty_rows_.erase(dirty_rows_.begin() + borders_.back() + right_shift,
+                      dirty_rows_.begin() + borders_.back());
+  } else if (right_shift > 0) {
+    dirty_rows_.insert(dirty_rows_.begin() + borders_.back(), right_shift, 1);
+    auto position = field_.begin() + borders_.back();
+    for (long long j = right_shift - 1; j >= 0; --j) {
+      position = field_.insert(position, CyclicVector<char>());
+      position->assign(right_in.begin() + j * width,
+                       right_in.begin() + (j + 1) * width);
+    }
+  }
+  if (left_shift > 0) {
+    field_.erase(field_.begin() + borders_[0],
+                 field_.begin() + borders_[0] + left_shift);
+    dirty_rows_.erase(dirty_rows_.begin() + borders_[0],
+                      dirty_rows_.begin() + borders_[0] + left_shift);
+  } else if (left_shift < 0) {
+    dirty_rows_.insert(dirty_rows_.begin() + borders_[0], -left_shift, 1);
+    auto position = field_.begin() + borders_[0];
+    for (long long j = -left_shift - 1; j >= 0; --j) {
+      position = field_.insert(position, CyclicVector<char>());
+      position->assign(left_in.begin() + j * width,
+                       left_in.begin() + (j + 1) * width);
+    }
+  }
+  rows += right_shift - left_shift;
+  borders_.back() = borders_[0] + rows;
+  global_offset_ = new_borders[index];
+  new_field_.resize(field_.size());
+  for (auto& line : new_field_) {
+    line.resize(width);
+  }
+}
+
+void GameOfLife::CalculatePart() {
+  Census census;
+  CalculateRows(field_, new_field_, rules_, borders_[0], borders_.back(),
+                global_offset_ - borders_[0], census,
+                [this](const long long i, const bool changed) {
+                  if (changed) {
+                    dirty_rows_[i] = 1;
+                  }
+                });
+  census_part_ = census;
+}
+
+void GameOfLife::StartCensusReduce() {
+  FinishCensusReduce(true);
+  census_generation_ = iterations_count_;
+  census_sums_[0] = static_cast<long long>(census_part_.population_);
+  census_sums_[1] = static_cast<long long>(census_part_.births_);
+  census_sums_[2] = static_cast<long long>(census_part_.deaths_);
+  census_extents_[0] = -census_part_.min_row_;
+  census_extents_[1] = census_part_.max_row_;
+  census_extents_[2] = -census_part_.min_col_;
+  census_extents_[3] = census_part_.max_col_;
+  MPI_Ireduce(census_sums_, census_sums_result_, 3, MPI_LONG_LONG, MPI_SUM, 0,
+      slaves_comm_, &census_requests_[0]);
+  MPI_Ireduce(census_extents_, census_extents_result_, 4, MPI_LONG_LONG,
+      MPI_MAX, 0, slaves_comm_, &census_requests_[1]);
+}
+
+void GameOfLife::FinishCensusReduce(const bool blocking) {
+  if (census_requests_[0] == MPI_REQUEST_NULL &&
+      census_requests_[1] == MPI_REQUEST_NULL) {
+    return;
+  }
+  if (blocking) {
+    MPI_Waitall(2, census_requests_, MPI_STATUSES_IGNORE);
+  } else {
+    int completed = 0;
+    MPI_Testall(2, census_requests_, &completed, MPI_STATUSES_IGNORE);
+    if (!completed) {
+      return;
+    }
+  }
+  if (world_rank_ != 1) {
+    return;
+  }
+  Census census;
+  census.generation_ = census_generation_;
+  census.population_ = static_cast<uint64_t>(census_sums_result_[0]);
+  census.births_ = static_cast<uint64_t>(census_sums_result_[1]);
+  census.deaths_ = static_cast<uint64_t>(census_sums_result_[2]);
+  census.min_row_ = -census_extents_result_[0];
+  census.max_row_ = census_extents_result_[1];
+  census.min_col_ = -census_extents_result_[2];
+  census.max_col_ = census_extents_result_[3];
+  census_.Add(census);
+}
+
+void GameOfLife::SlaveCheckpoint(const std::string& filename,
+                                 std::vector<long long>& info) {
+  // Предыдущая точка дописывается до начала новой: ее слот остается
+  // резервным, пока пишется новая.
+  bool previous_valid = FinishCheckpointWrite() && checkpoint_file_ == filename;
+  checkpoint_slot_ = checkpoint_file_ == filename ? 1 - checkpoint_slot_ : 0;
+  info = {previous_valid ? 1 : 0,
+          static_cast<long long>(checkpoint_generation_),
+          static_cast<long long>(1 - checkpoint_slot_),
+          checkpoint_offset_,
+          checkpoint_rows_};
+
+  checkpoint_file_ = filename;
+  checkpoint_generation_ = iterations_count_;
+  checkpoint_offset_ = global_offset_;
+  checkpoint_rows_ = borders_.back() - borders_[0];
+  info.insert(info.end(), {static_cast<long long>(checkpoint_generation_),
+                           static_cast<long long>(checkpoint_slot_),
+                           checkpoint_offset_, checkpoint_rows_});
+
+  checkpoint_strip_.resize(checkpoint_rows_);
+  for (long long i = 0; i < checkpoint_rows_; ++i) {
+    checkpoint_strip_[i] = field_[borders_[0] + i];
+  }
+  std::string strip_name = CheckpointStripName(filename, checkpoint_slot_,
+                                               world_rank_ - 1);
+  std::string rules = RulesString(rules_);
+  size_t generation = checkpoint_generation_;
+  checkpoint_thread_ = std::thread([this, strip_name, rules, generation]() {
+    checkpoint_written_ = SaveBinaryBoardAtomically(
+        strip_name, checkpoint_strip_, rules, generation);
+  });
+}
+
+void GameOfLife::SlaveAutoCheckpoint(bool& quit) {
+  std::vector<long long> info;
+  SlaveCheckpoint(auto_checkpoint_file_, info);
+
+  std::vector<long long> infos;
+  if (world_rank_ == 1) {
+    infos.resize((world_size_ - 1) * kCheckpointInfoSize);
+  }
+  std::vector<MPI_Request> requests(1);
+  MPI_Igather(info.data(), kCheckpointInfoSize, MPI_LONG_LONG, infos.data(),
+      kCheckpointInfoSize, MPI_LONG_LONG, 0, slaves_comm_, &requests[0]);
+  SlaveWait(requests, false, quit);
+  if (world_rank_ == 1) {
+    WriteCheckpointManifest(auto_checkpoint_file_, infos);
+  }
+}
+
+bool GameOfLife::FinishCheckpointWrite() {
+  if (checkpoint_thread_.joinable()) {
+    checkpoint_thread_.join();
+  }
+  return checkpoint_written_;
+}
+
+bool GameOfLife::WriteCheckpointManifest(const std::string& filename,
+                                         const std::vector<long long>& infos) {
+  int slaves_count = world_size_ - 1;
+  std::vector<CheckpointEntry> entries(2);
+  bool previous_valid = true;
+  for (int i = 0; i < slaves_count; ++i) {
+    const long long* info = &infos[i * kCheckpointInfoSize];
+    previous_valid = previous_valid && info[0] != 0 && info[1] == infos[1];
+    entries[1].borders_.push_back(info[3]);
+    entries[0].borders_.push_back(info[7]);
+  }
+  const long long* last = &infos[(slaves_count - 1) * kCheckpointInfoSize];
+  entries[1].generation_ = infos[1];
+  entries[1].slot_ = infos[2];
+  entries[1].borders_.push_back(last[3] + last[4]);
+  entries[0].generation_ = infos[5];
+  entries[0].slot_ = infos[6];
+  entries[0].borders_.push_back(last[7] + last[8]);
+  if (!previous_valid) {
+    entries.pop_back();
+  }
+  return SaveCheckpointManifest(filename, entries[0].borders_.back(),
+                                field_[0].size(), RulesString(rules_),
+                                entries);
+}
+
 void GameOfLife::BroadcastField() {
   for (int i = 1; i < world_size_; ++i) {
     process_.push_back(i);
   }
 
   if (world_rank_ == 0) {
-    char x = 1;
-    for (int i = 1; i < world_size_; ++i) { // Оповещаем все процессы о старте.
-      MPI_Send(&x, 1, MPI_BYTE, i, MpiGolTag::Start, mpi_comm_);
-    }
+    SendCommand(static_cast<int>(MpiGolCommand::Start));
+
+    // Поле могло быть загружено вместе со своими правилами.
+    char rules[kRulesLength] = {};
+    RulesString(rules_).copy(rules, kRulesLength - 1);
+    // Теневых строк с каждой стороны участка столько, каков радиус правил.
+    long long depth = rules_.radius_;
 
     borders_.push_back(0);
     borders_.push_back(0);
@@ -425,45 +1368,63 @@ void GameOfLife::BroadcastField() {
     }
 
     for (int i = 1; i < world_size_; ++i) {
-      long long size[2] = {borders_[i + 1] - borders_[i] + 2,
-                           static_cast<long long>(field_[0].size())};
-      MPI_Send(size, 2, MPI_LONG_LONG, i, MpiGolTag::FieldSize, mpi_comm_);
-      for (long long j = borders_[i] - 1; j < borders_[i + 1] + 1; ++j) {
-        MPI_Send(field_[j].data(), static_cast<int>(size[1]), MPI_BYTE, i,
-            MpiGolTag::Field, mpi_comm_);
+      long long size[4] = {borders_[i + 1] - borders_[i] + 2 * depth,
+                           static_cast<long long>(field_[0].size()),
+                           borders_[i],
+                           static_cast<long long>(iterations_count_)};
+      MPI_Send(size, 4, MPI_LONG_LONG, i, MpiGolTag::FieldSize, mpi_comm_);
+      MPI_Send(rules, kRulesLength, MPI_CHAR, i, MpiGolTag::Rules, mpi_comm_);
+      std::vector<long long> rows;
+      for (long long j = borders_[i] - depth; j < borders_[i + 1] + depth;
+           ++j) {
+        rows.push_back(j);
       }
+      SendRows(rows, i, MpiGolTag::Field);
     }
   } else {
-    long long size[2];
-    MPI_Recv(size, 2, MPI_LONG_LONG, 0, MpiGolTag::FieldSize, mpi_comm_,
+    long long size[4];
+    MPI_Recv(size, 4, MPI_LONG_LONG, 0, MpiGolTag::FieldSize, mpi_comm_,
         MPI_STATUS_IGNORE);
+    char rules[kRulesLength];
+    MPI_Recv(rules, kRulesLength, MPI_CHAR, 0, MpiGolTag::Rules, mpi_comm_,
+        MPI_STATUS_IGNORE);
+    rules_ = ParseRules(rules);
+    iterations_count_ = desired_iterations_count_ = size[3];
+    std::vector<long long> rows;
     for (long long i = 0; i < size[0]; ++i) {
       field_.push_back(CyclicVector<char>());
       field_[i].assign(size[1], 0);
-      MPI_Recv(field_[i].data(), static_cast<int>(size[1]), MPI_BYTE, 0,
-          MpiGolTag::Field, mpi_comm_, MPI_STATUS_IGNORE);
+      rows.push_back(i);
     }
+    RecvRows(rows, 0, MpiGolTag::Field);
+    global_offset_ = size[2];
+    dirty_rows_.assign(size[0], 0);
 
-    borders_.push_back(1);
-    borders_.push_back(size[0] - 1);
+    borders_.push_back(rules_.radius_);
+    borders_.push_back(size[0] - rules_.radius_);
   }
 }
 
+size_t GameOfLife::SlavesMinRows() const {
+  return static_cast<size_t>(rules_.radius_) * (world_size_ - 1);
+}
+
 bool GameOfLife::Running() {
   if (!running_) {
     return false;
   }
 
   if (world_rank_ == 0) {
-    running_ = false;
-    bool locally_running;
-    char x = 1;
-    for (int i = 1; i < world_size_; ++i) {
-      MPI_Send(&x, 1, MPI_BYTE, i, MpiGolTag::Running, mpi_comm_);
-      MPI_Recv(&locally_running, 1, MPI_CXX_BOOL, i, MpiGolTag::Running,
-          mpi_comm_, MPI_STATUS_IGNORE);
-      running_ = running_ || locally_running;
-    }
+    SendCommand(static_cast<int>(MpiGolCommand::Running));
+    // Рабы отвечают, не прерывая счет: флаг работы и номер итерации.
+    unsigned long local_state[2] = {0, 0};
+    unsigned long global_state[2] = {0, 0};
+    MPI_Request request;
+    MPI_Iallreduce(local_state, global_state, 2, MPI_UNSIGNED_LONG, MPI_MAX,
+        control_comm_, &request);
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+    running_ = global_state[0] != 0;
+    iterations_count_ = global_state[1];
   }
 
   return running_;
@@ -1,35 +1,106 @@
 #pragma once
+#include <string>
+#include <thread>
 #include <vector>
 
+#include "census.hpp"
 #include "cyclic_vector.hpp"
+#include "edits.hpp"
+#include "engine.hpp"
+#include "field_view.hpp"
+#include "rules.hpp"
+#include "time_histogram.hpp"
 
-class GameOfLife {
+class GameOfLife : public Engine {
  public:
-  // Конструктор от правил игры.
-  explicit GameOfLife(const std::string& rules = "b3/s23");
+  // Способ обмена граничными строками между рабами.
+  enum class HaloMode {
+    TwoSided,  // MPI_Isend/MPI_Irecv
+    Rma        // MPI_Put в окна соседей
+  };
+
+ public:
+  // Конструктор от правил игры и способа обмена границами. При shared_memory
+  // рабы одного узла обмениваются границами через общую память. При
+  // sparse_rows строки с малым числом живых клеток передаются разреженно.
+  explicit GameOfLife(const std::string& rules = "b3/s23",
+                      const HaloMode halo_mode = HaloMode::TwoSided,
+                      const bool shared_memory = true,
+                      const bool sparse_rows = false);
 
   // Создание поля h_size x v_size с рандомными значениями.
-  bool Start(const size_t h_size = 10, const size_t v_size = 10);
+  bool Start(const size_t h_size = 10, const size_t v_size = 10) override;
 
-  // Загрузка поля из .csv файла.
-  bool Start(const std::string& filename);
+  // Загрузка поля из .csv файла, паттерна RLE или двоичного файла,
+  // сохраненного Save. Двоичный файл задает также правила и номер итерации,
+  // RLE - правила, если они указаны. Паттерн RLE помещается в центр поля
+  // размера не меньше h_size x v_size.
+  bool Start(const std::string& filename, const size_t h_size = 0,
+             const size_t v_size = 0) override;
 
   // Запуск процесса выполнения нескольких итераций перерасчета поля.
-  bool Run(const size_t num_iterations);
+  bool Run(const size_t num_iterations) override;
+
+  // Ожидание окончания запущенных итераций.
+  bool Wait() override;
 
   // Досрочная остановка вычислений.
-  bool Stop(const size_t final_iterations_count = 0);
+  bool Stop();
 
-  // Обновление поля путем сбора кусочков с каждого процесса.
+  // Обновление поля путем сбора изменившихся строк с каждого процесса.
   bool Update();
 
+  // Сбор поля и сохранение его в двоичный файл вместе с правилами и номером
+  // итерации. Только для мастера и только для остановленного поля.
+  bool Save(const std::string& filename) override;
+
+  // Контрольная точка: каждый раб пишет свой участок фоновым потоком, мастер
+  // пишет манифест с границами участков. Идущие вычисления прерываются
+  // только на время копирования участков. Только для мастера.
+  bool Checkpoint(const std::string& filename);
+
+  // Автоматическая контрольная точка в filename на каждой every-й итерации.
+  // Манифест пишет первый раб. При every = 0 точки отключаются.
+  void SetAutoCheckpoint(const std::string& filename, const size_t every);
+
+  // Восстановление поля из контрольной точки или файла, сохраненного Save.
+  bool Restore(const std::string& filename);
+
+  // Правка клеток. Идущие вычисления приостанавливаются, как для
+  // контрольной точки: правки применяются всеми рабами на одной итерации.
+  // Только для мастера.
+  bool Edit(const std::vector<CellEdit>& edits);
+
   // Остановка всех вычислений и завершение процессов.
-  void Quit();
+  void Quit() override;
 
   // Вывод всего поля. Можно использовать только когда заранее известно,
   // что все процессы остановлены.
   void PrintField(std::ostream& out = std::cout);
 
+  // Сбор поля и вывод окна из w x h клеток с левым верхним углом в столбце
+  // x строки y, при zoom > 1 - блоками zoom x zoom клеток. Только для
+  // мастера. Возвращает false, если поля нет или вычисления идут.
+  bool View(const long long x, const long long y, const size_t w,
+            const size_t h, const size_t zoom, std::ostream& out = std::cout);
+
+  // Сбор у рабов времени этапов итерации (счет, ожидание граничных строк,
+  // балансировка) и объема обмена границами. Таблицей или в JSON. Только
+  // для мастера, возможен и во время вычислений.
+  bool PrintStats(const bool json, std::ostream& out = std::cout);
+
+  // Сброс статистики рабов. Только для мастера.
+  bool ResetStats();
+
+  // Вывод сводок (население, рождения, смерти, ограничивающий
+  // прямоугольник) последних count итераций. Сводки собирает первый раб,
+  // последняя итерация может быть еще не собрана.
+  bool PrintCensus(const size_t count, std::ostream& out = std::cout);
+
+  // Запись сводки каждой следующей итерации в файл CSV первым рабом. При
+  // пустом filename запись прекращается.
+  bool RecordCensus(const std::string& filename) override;
+
   // Состояние класса. В случае бездействия процессов возвращает true.
   bool PrintStatus(std::ostream& out = std::cout);
 
@@ -39,16 +110,121 @@ class GameOfLife {
   // Процесс синхронизации раба с остальными процессами.
   void SlaveSynchronize();
 
-  // Обработка сообщений для раба.
-  void SlaveRecv(bool* border_gained, bool& quit, bool& notify_master);
-
   // Содержательная часть игры "Жизнь".
   void CalculatePart();
 
  private:
+  // Этапы итерации раба, время которых замеряется.
+  enum SlavePhase {
+    Compute,   // CalculatePart.
+    HaloWait,  // Ожидание граничных строк соседей.
+    Balance,   // Перераспределение строк.
+    SlavePhasesCount
+  };
+
+  // Состояние раба при досрочной остановке.
+  enum class StopState {
+    None,
+    Reducing,   // ждет итерацию остановки, новых итераций не начинает
+    Finishing   // досчитывает до итерации остановки
+  };
+
+ private:
+  // Рассылка команды мастером всем рабам по управляющему коммуникатору.
+  void SendCommand(const int command, const unsigned long argument = 0);
+
+  // Досрочная остановка вычислений. Возвращает число итераций, которые
+  // осталось посчитать.
+  size_t Pause();
+
+  // Рассылка строки мастера рабам по управляющему коммуникатору.
+  void BroadcastString(std::string& str);
+
+  // Обработка событий управляющего коммуникатора для раба. В режиме blocking
+  // дожидается хотя бы одного события. mid_generation означает, что раб
+  // находится посреди итерации.
+  void SlaveControl(const bool blocking, const bool mid_generation, bool& quit);
+
+  // Выполнение пришедшей рабу команды мастера.
+  void SlaveCommand(const bool mid_generation, bool& quit);
+
+  // Применение рабом правок (строка, столбец, состояние) к строкам своего
+  // участка.
+  void SlaveApplyEdits(const std::vector<long long>& edits);
+
+  // Сообщает мастеру, что раб дошел до итерации остановки.
+  void SlaveFinishStop();
+
+  // Отправка мастеру строк участка, изменившихся с прошлого сбора.
+  void SlaveSendPart();
+
+  // Отправка строк rows одним сообщением в закодированном виде.
+  void SendRows(const std::vector<long long>& rows, const int dest,
+                const int tag);
+
+  // Прием строк, отправленных SendRows, в строки rows.
+  void RecvRows(const std::vector<long long>& rows, const int source,
+                const int tag);
+
+  // Ожидание завершения запросов раба с обработкой команд мастера.
+  void SlaveWait(std::vector<MPI_Request>& requests, const bool mid_generation,
+                 bool& quit);
+
+  // Обмен граничными строками с соседними рабами: с каждой стороны столько
+  // строк, каков радиус правил.
+  void ExchangeBorders(bool& quit);
+
+  // Проверяет, пришли ли граничные строки со стороны side (0 - от
+  // предыдущего раба, 1 - от следующего), и переносит их в теневые строки.
+  bool BorderArrived(const int side, const int parity,
+                     const unsigned long flag);
+
+  // Копирует крайние строки участка в свой сегмент общей памяти узла.
+  void PublishSharedBorders(const int parity, const unsigned long flag);
+
+  // Создание и удаление окон для одностороннего обмена границами.
+  void CreateHaloWindows();
+  void FreeHaloWindows();
+
+  // Создание и удаление окна общей памяти рабов одного узла.
+  void CreateSharedWindow();
+  void FreeSharedWindow();
+
+  // Запуск редукции сводок участков итерации census_part_ к первому рабу.
+  // Предыдущая редукция перед этим завершается.
+  void StartCensusReduce();
+
+  // Завершение редукции сводок: первый раб добавляет итог в census_. Без
+  // blocking только проверяет, завершилась ли она.
+  void FinishCensusReduce(const bool blocking);
+
+  // Перераспределение строк между соседними рабами по замерам времени счета.
+  void BalanceLoad(bool& quit);
+
+  // Копирование участка раба в контрольную точку filename и запуск его
+  // фоновой записи. В info записывается описание участка для манифеста.
+  void SlaveCheckpoint(const std::string& filename,
+                       std::vector<long long>& info);
+
+  // Автоматическая контрольная точка. Описания участков собираются у первого
+  // раба, он и пишет манифест.
+  void SlaveAutoCheckpoint(bool& quit);
+
+  // Ожидание окончания фоновой записи участка. Возвращает false, если
+  // запись не удалась.
+  bool FinishCheckpointWrite();
+
+  // Запись манифеста по описаниям участков всех рабов.
+  bool WriteCheckpointManifest(const std::string& filename,
+                               const std::vector<long long>& infos);
+
   // Распределение поля между процессами.
   void BroadcastField();
 
+  // Наименьшая высота поля: каждому рабу нужно не меньше строк, чем радиус
+  // правил, - столько теневых строк берут у него соседи.
+  size_t SlavesMinRows() const;
+
   // Обновляет состояние обработки поля.
   bool Running();
 
@@ -56,20 +232,95 @@ class GameOfLife {
   CyclicVector<CyclicVector<char>> field_;
   CyclicVector<CyclicVector<char>> new_field_;
 
+  // Население плиток поля мастера, пересчитывается по собранным строкам.
+  TilePopulation population_;
+
   size_t iterations_count_;
   size_t desired_iterations_count_;
   bool running_;
   bool up_to_date_;
   std::vector<long long> borders_; // Границы участков поля для процессов.
+  long long global_offset_;  // Номер первой строки участка раба в поле.
+  // Строки участка раба, изменившиеся с последнего сбора поля мастером.
+  std::vector<char> dirty_rows_;
   CyclicVector<int> process_;  // Номера процессов, обрабатывающих поле.
 
   MPI_Comm mpi_comm_;
+  MPI_Comm slaves_comm_;  // Группа рабов без мастера.
+  // Копия mpi_comm_ для команд мастера, чтобы они не смешивались с обменом
+  // границами.
+  MPI_Comm control_comm_;
+  // Незавершенные запросы раба к control_comm_: рассылка команды, редукция,
+  // барьер.
+  MPI_Request control_requests_[3];
+  unsigned long control_message_[2];  // Команда и ее аргумент.
+  unsigned long reduce_send_[2];
+  unsigned long reduce_result_[2];
+  StopState stop_state_;
+
+  HaloMode halo_mode_;
+  bool sparse_rows_;
+  // Закодированные граничные строки: отправляемые соседям и принимаемые от
+  // них (сначала предыдущий сосед, затем следующий).
+  std::vector<unsigned char> halo_out_[2];
+  std::vector<unsigned char> halo_in_[2];
+  // Окно с закодированными теневыми строками раба: по два места (сверху и
+  // снизу) на радиус правил строк на каждую четность итерации, чтобы сосед
+  // мог писать следующую итерацию, пока текущая еще не прочитана.
+  MPI_Win halo_window_;
+  std::vector<unsigned char> halo_buffer_;
+  // Окно с номерами итераций (плюс один), строки которых уже записаны в
+  // соответствующие места halo_buffer_.
+  MPI_Win halo_flags_window_;
+  std::vector<unsigned long> halo_flags_;
+
+  bool shared_memory_;
+  MPI_Comm node_comm_;  // Рабы, работающие на одном узле.
+  // Окно общей памяти узла. Сегмент каждого раба: номера опубликованных
+  // итераций (плюс один) для каждой четности, затем первые и последние
+  // строки участка (по радиусу правил) для каждой четности.
+  MPI_Win shared_window_;
+  char* shared_segment_;
+  // Сегменты соседей на том же узле (сначала предыдущего, затем следующего)
+  // или nullptr, если сосед на другом узле.
+  char* shared_neighbor_[2];
   int world_size_;
   int world_rank_;
 
-  struct Rules {  // Правила игры. Числа окружающих живых ячеек, при которых
-    std::vector<char> born_;  // ячейка рождается,
-    std::vector<char> stay_;  // ячейка остается жить.
-  };
+  // Время счета раба с момента последней балансировки, в секундах.
+  double calculation_time_;
+
+  // Статистика раба: время этапов и байты граничных строк, отправленные и
+  // принятые с начала работы или сброса.
+  TimeHistogram phases_[SlavePhasesCount];
+  uint64_t halo_bytes_sent_;
+  uint64_t halo_bytes_received_;
+
+  // Сводка участка раба за последнюю итерацию, считается в CalculatePart.
+  Census census_part_;
+  // Редукция сводок по slaves_comm_: суммы населения, рождений и смертей и
+  // максимумы границ прямоугольника (минимумы - с обратным знаком).
+  long long census_sums_[3];
+  long long census_extents_[4];
+  long long census_sums_result_[3];
+  long long census_extents_result_[4];
+  MPI_Request census_requests_[2];
+  size_t census_generation_;  // Итерация незавершенной редукции.
+  // Ряд сводок поля. Ведет только первый раб.
+  CensusLog census_;
+
+  std::string auto_checkpoint_file_;
+  size_t auto_checkpoint_every_;  // 0, если автоматических точек нет.
+  // Последняя контрольная точка раба: файл, слот, итерация и участок.
+  std::string checkpoint_file_;
+  size_t checkpoint_slot_;
+  size_t checkpoint_generation_;
+  long long checkpoint_offset_;
+  long long checkpoint_rows_;
+  // Копия участка, которую пишет checkpoint_thread_.
+  CyclicVector<CyclicVector<char>> checkpoint_strip_;
+  std::thread checkpoint_thread_;
+  bool checkpoint_written_;  // Результат последней записи.
+
   Rules rules_;
 };
\ No newline at end of file
@@ -1,9 +1,11 @@
+#include <chrono>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <vector>
 
 #include "mpi.h"
+#include "batch.hpp"
 #include "game_of_life.hpp"
 
 bool StrIsInt(const std::string& str) {
@@ -17,21 +19,70 @@ bool StrIsInt(const std::string& str) {
 
 void PrintHelp() {
   std::cout << "Conway\'s Game of Life.\n"
-               "Run with mpirun."
-               "Arguments: <rules>\n"
+               "Run with mpirun.\n"
+               "Arguments: <rules> <halo exchange> [no-shm] [sparse]\n"
+               "\tor batch mode arguments starting with -- (see --help)\n"
                "Rules:\n"
                "\tThe rules are set as a first argument of the program in "
                "format (regexp) b\\d+/s\\d+,\n\twhere digits after b are "
                "associated with numbers of alive cells around a cell\n\tneeded "
                "to bring the dead cell alive, and digits after s - to keep the "
                "cell alive.\n\tOriginal rules are b3/s23.\n"
+               "\tLarger than Life rules are set as r<r>,m<0|1>,s<a>..<b>,"
+               "b<d>..<e>:\n\ta cell looks at (2r + 1) x (2r + 1) cells "
+               "around it (itself included\n\tif m1), survives with a to b "
+               "of them alive and is born with d to e.\n\tOptional fields "
+               "c0 (two states, c1 and c2 mean the same) and nm\n\t(Moore "
+               "neighborhood) are the only values supported and are left "
+               "out\n\twhen the rules are saved. For example "
+               "r5,c0,m1,s34..58,b34..45,nm\n\t(Bosco) is saved as "
+               "r5,m1,s34..58,b34..45; r is at most 31.\n"
+               "\tGenerations rules (b2/s/c3) are run by gol_pthread only.\n"
+               "Halo exchange:\n"
+               "\ttwo-sided - border rows are sent with MPI_Isend/MPI_Irecv "
+               "(default),\n"
+               "\trma - border rows are written to neighbours' windows with "
+               "MPI_Put.\n"
+               "\tRanks on the same node read each other's border rows from "
+               "shared memory;\n\tpass no-shm to use messages for them too.\n"
+               "\tRows are sent packed at one bit per cell; pass sparse to "
+               "send\n\tmostly dead rows as lists of alive cells.\n"
                "Commands:\n"
                "\tstart <n> <m> - create a field sized (n x m) with "
                "number of alive and dead cells\n"
                "\tstart <filename> - create a field from \'filename\' "
-               "file (should be .csv format)\n"
+               "file (.csv format, .rle\n\t\tpattern or binary field saved "
+               "with save)\n"
+               "\tstart <filename> <n> <m> - place an .rle pattern in the "
+               "middle of a field\n\t\tsized at least (n x m)\n"
+               "\tsave <filename> - save the stopped field with its rules "
+               "and iteration\n\t\tto a binary file\n"
+               "\tcheckpoint <filename> - write the field to 'filename' in "
+               "the background,\n\t\tcalculations continue\n"
+               "\tcheckpoint <filename> <k> - checkpoint every k-th "
+               "iteration\n"
+               "\tcheckpoint off - disable automatic checkpoints\n"
+               "\trestore <filename> - create a field from a checkpoint\n"
                "\tstatus - show current game status\n"
+               "\tstats [json] - show time spent by slaves in each phase of "
+               "iterations\n\t\tand bytes of exchanged borders\n"
+               "\tstats reset - reset slave statistics\n"
+               "\tcensus [<n>] - show population, births, deaths and bounding "
+               "box of\n\t\tthe last n iterations (10)\n"
+               "\tcensus record <filename> - write them for every next "
+               "iteration\n\t\tto a .csv file\n"
+               "\tcensus off - stop writing them\n"
+               "\tview <x> <y> <w> <h> [<zoom>] - show (w x h) cells of the "
+               "stopped field\n\t\tstarting at column x, row y; with zoom "
+               "each (zoom x zoom) block\n\t\tis shown by its density\n"
+               "\tset <x> <y> - make the cell at column x, row y alive; "
+               "running\n\t\titerations are paused for it\n"
+               "\tclear <x> <y> - make the cell at column x, row y dead\n"
+               "\tpaste <filename> <x> <y> - put an .rle or .csv pattern "
+               "with its top left\n\t\tcorner at column x, row y\n"
                "\trun <n> - run n iterations of game\n"
+               "\twait - wait for the running iterations to finish and show "
+               "the time\n\t\tsince the last run\n"
                "\tstop - stop calculations if any\n"
                "\tquit - quit program\n"
                "\thelp - show help\n"
@@ -40,8 +91,28 @@ void PrintHelp() {
 
 int main(int argc, char** argv) {
   std::string rules = "b3/s23";
-  if (argc >= 2) {
-    rules = argv[1];
+  GameOfLife::HaloMode halo_mode = GameOfLife::HaloMode::TwoSided;
+  bool shared_memory = true;
+  bool sparse_rows = false;
+  // Ошибки аргументов пакетного режима выводит только мастер.
+  bool batch = IsBatchMode(argc, argv);
+  BatchOptions options;
+  std::ostringstream batch_errors;
+  bool batch_correct =
+      batch && ParseBatchOptions(argc, argv, options, batch_errors);
+  for (int i = 1; i < argc && !batch; ++i) {
+    std::string arg = argv[i];
+    if (arg == "rma") {
+      halo_mode = GameOfLife::HaloMode::Rma;
+    } else if (arg == "two-sided") {
+      halo_mode = GameOfLife::HaloMode::TwoSided;
+    } else if (arg == "no-shm") {
+      shared_memory = false;
+    } else if (arg == "sparse") {
+      sparse_rows = true;
+    } else {
+      rules = arg;
+    }
   }
 
   MPI_Init(nullptr, nullptr);
@@ -51,9 +122,40 @@ int main(int argc, char** argv) {
   int world_rank;
   MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
 
-  GameOfLife gol(rules);
+  if (batch && !batch_correct) {
+    if (world_rank == 0) {
+      std::cerr << batch_errors.str();
+      PrintBatchHelp(std::cerr);
+    }
+    MPI_Finalize();
+    return 1;
+  }
+  if (batch) {
+    rules = options.rules;
+  }
+  if (ParseRules(rules).states_ > 2) {
+    if (world_rank == 0) {
+      std::cerr << "Generations rules are supported by gol_pthread only "
+                   "(in batch mode).\n";
+    }
+    MPI_Finalize();
+    return 1;
+  }
+
+  GameOfLife gol(rules, halo_mode, shared_memory, sparse_rows);
   gol.SetMpiCommunicator(MPI_COMM_WORLD);
 
+  if (batch) {
+    int code = 0;
+    if (world_rank == 0) {
+      code = RunBatch(gol, options, std::cout, std::cerr);
+    } else {
+      gol.SlaveSynchronize();
+    }
+    MPI_Finalize();
+    return code;
+  }
+
   if (world_rank == 0) {
     for (size_t i = 0; i < 22; ++i) {
       std::cout << "\u2550";
@@ -66,6 +168,8 @@ int main(int argc, char** argv) {
     std::cout << "\n";
 
     bool quit = false;
+    // Время последней команды run, от него отсчитывает wait.
+    auto run_begin = std::chrono::steady_clock::now();
     while (!quit) {
       std::string line;
       std::getline(std::cin, line);
@@ -89,7 +193,12 @@ int main(int argc, char** argv) {
 
         bool correct;
         if (!StrIsInt(args[1])) {
-          correct = gol.Start(args[1]);
+          if (args.size() >= 4 && StrIsInt(args[2]) && StrIsInt(args[3])) {
+            correct = gol.Start(args[1], std::stol(args[2]),
+                                std::stol(args[3]));
+          } else {
+            correct = gol.Start(args[1]);
+          }
         } else {
           if (args.size() < 3) {
             std::cout << args[0] << ": not enough arguments\n";
@@ -101,7 +210,56 @@ int main(int argc, char** argv) {
         if (correct) {
           std::cout << "Successfully created field.\n";
         } else {
-          std::cout << "Field already created. Quit program to make a new one.\n";
+          std::cout << "Field already created, file could not be read or "
+                       "the field has\nfewer rows than slaves times the rules "
+                       "radius. Quit program to make a new one.\n";
+        }
+
+      } else if (args[0] == "save") {
+        if (args.size() < 2) {
+          std::cout << args[0] << ": not enough arguments\n";
+          continue;
+        }
+        if (gol.Save(args[1])) {
+          std::cout << "Saved field to " << args[1] << ".\n";
+        } else {
+          std::cout << args[0] << ": no field, still running or file could "
+                       "not be written.\n";
+        }
+
+      } else if (args[0] == "checkpoint") {
+        if (args.size() < 2 || args[1].empty()) {
+          std::cout << args[0] << ": not enough arguments\n";
+          continue;
+        }
+        if (args[1] == "off") {
+          gol.SetAutoCheckpoint("", 0);
+          std::cout << "Automatic checkpoints disabled.\n";
+        } else if (args.size() >= 3 && !args[2].empty()) {
+          if (!StrIsInt(args[2])) {
+            std::cout << args[0] << ": invalid argument.\n";
+            continue;
+          }
+          gol.SetAutoCheckpoint(args[1], std::stol(args[2]));
+          std::cout << "Checkpoint to " << args[1] << " every " << args[2]
+                    << " iterations.\n";
+        } else if (gol.Checkpoint(args[1])) {
+          std::cout << "Writing checkpoint to " << args[1] << ".\n";
+        } else {
+          std::cout << args[0] << ": no field has been created yet or "
+                       "manifest could not be written.\n";
+        }
+
+      } else if (args[0] == "restore") {
+        if (args.size() < 2) {
+          std::cout << args[0] << ": not enough arguments\n";
+          continue;
+        }
+        if (gol.Restore(args[1])) {
+          std::cout << "Successfully restored field.\n";
+        } else {
+          std::cout << args[0] << ": field already created or " << args[1]
+                    << " is not a checkpoint.\n";
         }
 
       } else if (args[0] == "status") {
@@ -109,6 +267,86 @@ int main(int argc, char** argv) {
           gol.PrintField();
         }
 
+      } else if (args[0] == "stats") {
+        if (args.size() >= 2 && args[1] == "reset") {
+          if (gol.ResetStats()) {
+            std::cout << "Statistics reset.\n";
+          } else {
+            std::cout << args[0] << ": no field has been created yet.\n";
+          }
+          continue;
+        }
+        gol.PrintStats(args.size() >= 2 && args[1] == "json");
+
+      } else if (args[0] == "census") {
+        if (args.size() >= 2 && (args[1] == "record" || args[1] == "off")) {
+          if (args[1] == "record" && (args.size() < 3 || args[2].empty())) {
+            std::cout << args[0] << ": not enough arguments\n";
+          } else if (gol.RecordCensus(args[1] == "off" ? "" : args[2])) {
+            std::cout << (args[1] == "off" ? "Census recording stopped.\n"
+                                           : "Recording census.\n");
+          } else {
+            std::cout << args[0] << ": could not open the file.\n";
+          }
+          continue;
+        }
+        if (args.size() >= 2 && !args[1].empty() && !StrIsInt(args[1])) {
+          std::cout << args[0] << ": invalid argument.\n";
+          continue;
+        }
+        gol.PrintCensus(args.size() >= 2 && !args[1].empty()
+                            ? std::stol(args[1])
+                            : 10);
+
+      } else if (args[0] == "view") {
+        if (args.size() < 5) {
+          std::cout << args[0] << ": not enough arguments\n";
+          continue;
+        }
+        bool valid = true;
+        for (size_t i = 1; i < args.size() && i < 6; ++i) {
+          valid = valid && ((i == 5 && args[i].empty()) || StrIsInt(args[i]));
+        }
+        if (!valid) {
+          std::cout << args[0] << ": invalid argument.\n";
+          continue;
+        }
+        size_t zoom = args.size() >= 6 && !args[5].empty()
+                          ? std::stol(args[5])
+                          : 1;
+        if (!gol.View(std::stol(args[1]), std::stol(args[2]),
+                      std::stol(args[3]), std::stol(args[4]), zoom)) {
+          gol.PrintStatus();
+        }
+
+      } else if (args[0] == "set" || args[0] == "clear" ||
+                 args[0] == "paste") {
+        size_t first = args[0] == "paste" ? 2 : 1;
+        if (args.size() < first + 2) {
+          std::cout << args[0] << ": not enough arguments\n";
+          continue;
+        }
+        if (!StrIsInt(args[first]) || !StrIsInt(args[first + 1])) {
+          std::cout << args[0] << ": invalid argument.\n";
+          continue;
+        }
+        long long x = std::stol(args[first]);
+        long long y = std::stol(args[first + 1]);
+        std::vector<CellEdit> edits;
+        if (args[0] == "paste") {
+          if (!LoadPatternEdits(args[1], x, y, edits)) {
+            std::cout << args[0] << ": could not load " << args[1] << ".\n";
+            continue;
+          }
+        } else {
+          edits.push_back({y, x, static_cast<char>(args[0] == "set")});
+        }
+        if (gol.Edit(edits)) {
+          std::cout << "Edited " << edits.size() << " cells.\n";
+        } else {
+          std::cout << args[0] << ": no field has been created yet.\n";
+        }
+
       } else if (args[0] == "run") {
         if (args.size() < 2) {
           std::cout << args[0] << ": not enough arguments\n";
@@ -122,9 +360,20 @@ int main(int argc, char** argv) {
           std::cout << args[0]
                     << ": no field has been created yet.\n";
         } else {
+          run_begin = std::chrono::steady_clock::now();
           std::cout << "Started running " << std::stol(args[1]) << " iterations.\n";
         }
 
+      } else if (args[0] == "wait") {
+        if (!gol.Wait()) {
+          std::cout << args[0] << ": no field has been created yet.\n";
+          continue;
+        }
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - run_begin;
+        std::cout << "Finished in " << elapsed.count() << " s.\n";
+        gol.PrintStatus();
+
       } else if (args[0] == "stop") {
         if (gol.Stop()) {
           gol.PrintStatus();
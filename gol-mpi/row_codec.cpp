@@ -0,0 +1,101 @@
+#include <algorithm>
+
+#include "row_codec.hpp"
+
+namespace {
+
+size_t VarintSize(size_t value) {
+  size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+void PutVarint(size_t value, std::vector<unsigned char>& out) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<unsigned char>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<unsigned char>(value));
+}
+
+const unsigned char* GetVarint(const unsigned char* data, size_t& value) {
+  value = 0;
+  for (int shift = 0; ; shift += 7) {
+    value |= static_cast<size_t>(*data & 0x7F) << shift;
+    if ((*data++ & 0x80) == 0) {
+      return data;
+    }
+  }
+}
+
+}  // namespace
+
+size_t MaxEncodedRowSize(const size_t width) {
+  return 1 + (width + 7) / 8;
+}
+
+void EncodeRow(const char* row, const size_t width, const bool allow_sparse,
+               std::vector<unsigned char>& out) {
+  size_t packed_size = (width + 7) / 8;
+
+  if (allow_sparse) {
+    // Размер разреженного кодирования считаем заранее, не выходя за packed.
+    size_t alive = 0;
+    size_t gaps_size = 0;
+    size_t previous = 0;
+    for (size_t j = 0; j < width && gaps_size < packed_size; ++j) {
+      if (row[j]) {
+        gaps_size += VarintSize(j - previous);
+        previous = j + 1;
+        ++alive;
+      }
+    }
+    if (gaps_size + VarintSize(alive) < packed_size) {
+      out.push_back(static_cast<unsigned char>(RowEncoding::Sparse));
+      PutVarint(alive, out);
+      previous = 0;
+      for (size_t j = 0; j < width; ++j) {
+        if (row[j]) {
+          PutVarint(j - previous, out);
+          previous = j + 1;
+        }
+      }
+      return;
+    }
+  }
+
+  out.push_back(static_cast<unsigned char>(RowEncoding::Packed));
+  size_t begin = out.size();
+  out.resize(begin + packed_size, 0);
+  unsigned char* bits = out.data() + begin;
+  for (size_t j = 0; j < width; ++j) {
+    bits[j / 8] |= static_cast<unsigned char>((row[j] & 1) << (j % 8));
+  }
+}
+
+const unsigned char* DecodeRow(const unsigned char* data, const size_t width,
+                               char* row) {
+  auto encoding = static_cast<RowEncoding>(*data++);
+
+  if (encoding == RowEncoding::Sparse) {
+    std::fill(row, row + width, 0);
+    size_t alive = 0;
+    data = GetVarint(data, alive);
+    size_t position = 0;
+    for (size_t i = 0; i < alive; ++i) {
+      size_t gap = 0;
+      data = GetVarint(data, gap);
+      position += gap;
+      row[position++] = 1;
+    }
+    return data;
+  }
+
+  for (size_t j = 0; j < width; ++j) {
+    row[j] = static_cast<char>((data[j / 8] >> (j % 8)) & 1);
+  }
+  return data + (width + 7) / 8;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+#include <vector>
+
+// Кодирование строк поля для передачи между процессами. В памяти клетка
+// занимает байт, в сообщении - не больше бита.
+//
+// Закодированная строка начинается с байта вида кодирования, затем идут
+//   Packed: (width + 7) / 8 байт, клетка j - бит j % 8 байта j / 8;
+//   Sparse: число живых клеток и расстояния между ними (varint).
+// Строки самоограничены, поэтому их можно записывать подряд.
+enum class RowEncoding : unsigned char {
+  Packed,
+  Sparse
+};
+
+// Наибольший размер закодированной строки ширины width.
+size_t MaxEncodedRowSize(const size_t width);
+
+// Дописывает закодированную строку в конец out. При allow_sparse выбирается
+// более короткое из двух кодирований, иначе всегда Packed.
+void EncodeRow(const char* row, const size_t width, const bool allow_sparse,
+               std::vector<unsigned char>& out);
+
+// Раскодирует строку в row и возвращает указатель на следующую за ней.
+const unsigned char* DecodeRow(const unsigned char* data, const size_t width,
+                               char* row);
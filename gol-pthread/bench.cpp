@@ -0,0 +1,318 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "game_of_life.hpp"
+
+// Неинтерактивный замер производительности игры на наборе конфигураций:
+// размеры поля, плотности, правила и числа потоков перебираются все со
+// всеми. Поля создаются по фиксированному зерну, поэтому результаты можно
+// сравнивать между коммитами и машинами.
+
+namespace {
+
+struct BenchOptions {
+  std::vector<size_t> sizes = {256, 1024};
+  std::vector<double> densities = {0.5};
+  std::vector<std::string> rules = {"b3/s23"};
+  std::vector<size_t> threads = {1, 2, 4};
+  size_t generations = 100;  // Итераций в замере пропускной способности.
+  size_t samples = 50;       // Отдельно замеренных итераций для задержек.
+  size_t warmup = 5;
+  unsigned seed = 1337;
+  std::string format = "csv";
+  bool perf = false;  // Счетчики процессора в замере пропускной способности.
+};
+
+struct BenchResult {
+  size_t size;
+  double density;
+  std::string rules;
+  size_t threads;
+  size_t generations;
+  double seconds;
+  double cell_updates_per_second;
+  // Задержка одной итерации в микросекундах.
+  double latency_p50;
+  double latency_p90;
+  double latency_p99;
+  double latency_max;
+  size_t rss_kb;  // Резидентная память процесса после замера.
+  // Счетчики процессора, отрицательные - недоступны или не замерялись.
+  double ipc;
+  double cache_miss_rate;
+  double memory_mb_per_second;
+};
+
+void PrintHelp() {
+  std::cout << "Game of Life benchmark.\n"
+               "Arguments:\n"
+               "\t--sizes <n,...> - square field sizes (256,1024)\n"
+               "\t--densities <p,...> - share of alive cells (0.5)\n"
+               "\t--rules <rules,...> - game rules (b3/s23)\n"
+               "\t--threads <k,...> - numbers of threads (1,2,4)\n"
+               "\t--generations <n> - iterations measured at once (100)\n"
+               "\t--samples <n> - iterations measured one by one for "
+               "latency (50)\n"
+               "\t--warmup <n> - iterations before measuring (5)\n"
+               "\t--seed <n> - seed of random fields (1337)\n"
+               "\t--format <csv|json> - output format (csv)\n"
+               "\t--perf <on|off> - sample CPU performance counters, "
+               "unavailable\n\t\tcounters are left empty (off)\n";
+}
+
+template <class T>
+bool ParseList(const std::string& str, std::vector<T>& values) {
+  values.clear();
+  std::istringstream in(str);
+  std::string item;
+  while (std::getline(in, item, ',')) {
+    std::istringstream item_in(item);
+    T value;
+    if (!(item_in >> value) || !item_in.eof()) {
+      return false;
+    }
+    values.push_back(value);
+  }
+  return !values.empty();
+}
+
+bool ParseOptions(int argc, char** argv, BenchOptions& options) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    std::string value = argv[i + 1];
+    std::vector<size_t> numbers;
+    bool correct = true;
+    if (key == "--sizes") {
+      correct = ParseList(value, options.sizes);
+    } else if (key == "--densities") {
+      correct = ParseList(value, options.densities);
+    } else if (key == "--rules") {
+      correct = ParseList(value, options.rules);
+    } else if (key == "--threads") {
+      correct = ParseList(value, options.threads);
+    } else if (key == "--generations" || key == "--samples" ||
+               key == "--warmup" || key == "--seed") {
+      correct = ParseList(value, numbers) && numbers.size() == 1;
+      if (correct) {
+        if (key == "--generations") {
+          options.generations = numbers[0];
+        } else if (key == "--samples") {
+          options.samples = numbers[0];
+        } else if (key == "--warmup") {
+          options.warmup = numbers[0];
+        } else {
+          options.seed = static_cast<unsigned>(numbers[0]);
+        }
+      }
+    } else if (key == "--format") {
+      options.format = value;
+      correct = value == "csv" || value == "json";
+    } else if (key == "--perf") {
+      options.perf = value == "on";
+      correct = value == "on" || value == "off";
+    } else {
+      correct = false;
+    }
+    if (!correct) {
+      std::cerr << "Invalid argument " << key << " " << value << "\n";
+      return false;
+    }
+  }
+  if (argc % 2 == 0) {
+    std::cerr << "Missing value of " << argv[argc - 1] << "\n";
+    return false;
+  }
+  for (auto values : {&options.sizes, &options.threads}) {
+    if (std::count(values->begin(), values->end(), 0) != 0) {
+      std::cerr << "Sizes and numbers of threads should be positive\n";
+      return false;
+    }
+  }
+  for (auto density : options.densities) {
+    if (!(density >= 0 && density <= 1)) {
+      std::cerr << "Densities should be between 0 and 1\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+// Резидентная память процесса из /proc/self/status.
+size_t ResidentMemoryKb() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmRSS:") == 0) {
+      return std::stoul(line.substr(6));
+    }
+  }
+  return 0;
+}
+
+double Percentile(const std::vector<double>& sorted, const double share) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t index = static_cast<size_t>(share * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+BenchResult RunConfiguration(const BenchOptions& options, const size_t size,
+                             const double density, const std::string& rules,
+                             const size_t threads) {
+  using Clock = std::chrono::steady_clock;
+  BenchResult result;
+  result.size = size;
+  result.density = density;
+  result.rules = rules;
+  result.threads = threads;
+  result.generations = options.generations;
+
+  GameOfLife gol(threads, rules);
+  gol.Start(size, size, density, options.seed);
+  if (options.warmup > 0) {
+    gol.Run(options.warmup);
+    gol.Wait();
+  }
+
+  gol.SetPerfCounters(options.perf);
+  auto begin = Clock::now();
+  if (options.generations > 0) {
+    gol.Run(options.generations);
+    gol.Wait();
+  }
+  std::chrono::duration<double> elapsed = Clock::now() - begin;
+  gol.SetPerfCounters(false);
+  PerfTotals perf;
+  gol.CollectPerf(perf);
+  result.ipc = perf.InstructionsPerCycle();
+  result.cache_miss_rate = perf.CacheMissRate();
+  double bandwidth = perf.MemoryBytesPerSecond();
+  result.memory_mb_per_second = bandwidth < 0 ? -1 : bandwidth / 1e6;
+  result.seconds = elapsed.count();
+  result.cell_updates_per_second =
+      result.seconds > 0 ? static_cast<double>(size) * size *
+                               options.generations / result.seconds
+                         : 0;
+
+  // Задержка включает запуск потоков на итерацию и ожидание ее окончания.
+  std::vector<double> latencies;
+  for (size_t i = 0; i < options.samples; ++i) {
+    auto sample_begin = Clock::now();
+    gol.Run(1);
+    gol.Wait();
+    std::chrono::duration<double, std::micro> sample =
+        Clock::now() - sample_begin;
+    latencies.push_back(sample.count());
+  }
+  std::sort(latencies.begin(), latencies.end());
+  result.latency_p50 = Percentile(latencies, 0.5);
+  result.latency_p90 = Percentile(latencies, 0.9);
+  result.latency_p99 = Percentile(latencies, 0.99);
+  result.latency_max = latencies.empty() ? 0 : latencies.back();
+  result.rss_kb = ResidentMemoryKb();
+
+  gol.Quit();
+  return result;
+}
+
+// Значение счетчика, пустое в CSV и null в JSON, если его нет.
+std::string PerfValue(const double value, const bool json) {
+  if (value < 0) {
+    return json ? "null" : "";
+  }
+  std::ostringstream out;
+  out << value;
+  return out.str();
+}
+
+void PrintCsv(const std::vector<BenchResult>& results, std::ostream& out) {
+  out << "size,density,rules,threads,generations,seconds,"
+         "cell_updates_per_second,latency_p50_us,latency_p90_us,"
+         "latency_p99_us,latency_max_us,rss_kb,ipc,cache_miss_rate,"
+         "memory_mb_per_s\n";
+  for (const auto& result : results) {
+    out << result.size << "," << result.density << "," << result.rules << ","
+        << result.threads << "," << result.generations << ","
+        << result.seconds << "," << result.cell_updates_per_second << ","
+        << result.latency_p50 << "," << result.latency_p90 << ","
+        << result.latency_p99 << "," << result.latency_max << ","
+        << result.rss_kb << "," << PerfValue(result.ipc, false) << ","
+        << PerfValue(result.cache_miss_rate, false) << ","
+        << PerfValue(result.memory_mb_per_second, false) << "\n";
+  }
+}
+
+void PrintJson(const BenchOptions& options,
+               const std::vector<BenchResult>& results, std::ostream& out) {
+  char host[256] = {};
+  gethostname(host, sizeof(host) - 1);
+  out << "{\n  \"host\": \"" << host << "\",\n"
+      << "  \"hardware_threads\": " << std::thread::hardware_concurrency()
+      << ",\n  \"seed\": " << options.seed << ",\n  \"results\": [";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const auto& result = results[i];
+    out << (i == 0 ? "\n" : ",\n") << "    {\"size\": " << result.size
+        << ", \"density\": " << result.density << ", \"rules\": \""
+        << result.rules << "\", \"threads\": " << result.threads
+        << ", \"generations\": " << result.generations
+        << ", \"seconds\": " << result.seconds
+        << ", \"cell_updates_per_second\": " << result.cell_updates_per_second
+        << ", \"latency_us\": {\"p50\": " << result.latency_p50
+        << ", \"p90\": " << result.latency_p90
+        << ", \"p99\": " << result.latency_p99
+        << ", \"max\": " << result.latency_max
+        << "}, \"rss_kb\": " << result.rss_kb
+        << ", \"ipc\": " << PerfValue(result.ipc, true)
+        << ", \"cache_miss_rate\": " << PerfValue(result.cache_miss_rate, true)
+        << ", \"memory_mb_per_s\": "
+        << PerfValue(result.memory_mb_per_second, true) << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc >= 2 && (std::string(argv[1]) == "help" ||
+                    std::string(argv[1]) == "--help")) {
+    PrintHelp();
+    return 0;
+  }
+  BenchOptions options;
+  if (!ParseOptions(argc, argv, options)) {
+    PrintHelp();
+    return 1;
+  }
+
+  std::vector<BenchResult> results;
+  for (auto size : options.sizes) {
+    for (auto density : options.densities) {
+      for (const auto& rules : options.rules) {
+        for (auto threads : options.threads) {
+          results.push_back(
+              RunConfiguration(options, size, density, rules, threads));
+          std::cerr << "size " << size << ", density " << density
+                    << ", rules " << rules << ", threads " << threads
+                    << ": " << results.back().cell_updates_per_second
+                    << " cell updates/s\n";
+        }
+      }
+    }
+  }
+
+  if (options.format == "json") {
+    PrintJson(options, results, std::cout);
+  } else {
+    PrintCsv(results, std::cout);
+  }
+  return 0;
+}
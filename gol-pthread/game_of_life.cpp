@@ -1,10 +1,14 @@
+#include <algorithm>
 #include <cassert>
+#include <iomanip>
 #include <iostream>
-#include <fstream>
 #include <random>
 #include <utility>
 
+#include "field_io.hpp"
 #include "game_of_life.hpp"
+#include "kernel.hpp"
+#include "streaming_engine.hpp"
 
 GameOfLife::GameOfLife(const size_t num_threads, const std::string& rules)
     : permission_(false),
@@ -14,40 +18,23 @@ GameOfLife::GameOfLife(const size_t num_threads, const std::string& rules)
       running_(false),
       quitting_(false),
       num_threads_(num_threads),
-      master_thread_(nullptr) {
-  bool set_born = true;
-  for (const auto& c : rules) {
-    if (c == 'b' || c == 'B') {
-      set_born = true;
-    } else if (c == 's' || c == 'S') {
-      set_born = false;
-    } else if (c == '/') {
-      set_born = !set_born;
-      continue;
-    } else if (c >= '0' && c <= '9') {
-      if (set_born) {
-        rules_.born_.push_back(c - '0');
-      } else {
-        rules_.stay_.push_back(c - '0');
-      }
-    }
-  }
-
-  // При плохих входных данных устанавливаем b3/s23.
-  if (rules_.born_.empty() && rules_.stay_.empty()) {
-    rules_.born_.push_back(3);
-    rules_.stay_.push_back(2);
-    rules_.stay_.push_back(3);
-  }
+      perf_enabled_(false),
+      master_thread_(nullptr),
+      record_pending_(false),
+      auto_checkpoint_every_(0),
+      checkpoint_pending_(false),
+      checkpoint_written_(true) {
+  rules_ = ParseRules(rules);
 }
 
-bool GameOfLife::Start(const size_t h_size, const size_t v_size) {
+bool GameOfLife::Start(const size_t h_size, const size_t v_size,
+                       const double density, const unsigned seed) {
   if (!field_.empty()) {
     return false;
   }
 
-  std::mt19937 rng(1337);
-  std::bernoulli_distribution bern(0.5);
+  std::mt19937 rng(seed);
+  std::bernoulli_distribution bern(density);
   for (size_t i = 0; i < h_size; ++i) {
     field_.push_back(CyclicVector<char>());
     for (size_t j = 0; j < v_size; ++j) {
@@ -55,66 +42,168 @@ bool GameOfLife::Start(const size_t h_size, const size_t v_size) {
     }
   }
   new_field_ = field_;
+  CountTiles(field_, population_);
+  new_population_ = population_;
 
   CreateThreads();
 
   return true;
 }
 
-bool GameOfLife::Start(const std::string& filename) {
+bool GameOfLife::Start(const std::string& filename, const size_t h_size,
+                       const size_t v_size) {
   if (!field_.empty()) {
     return false;
   }
 
-  std::ifstream fin(filename);
-  int c = 0;
-  for (size_t i = 0; !fin.eof(); ++i) {
-    for (size_t j = 0; !fin.eof(); ++j) {
-      c = fin.get();
-      if (fin.eof()) {
-        break;
-      }
-      if (c == ',') {
-        continue;
-      }
-      if (c == '\n') {
-        break;
-      }
-
-      if (j == 0) {
-        field_.push_back(CyclicVector<char>());
-      }
-      field_[i].push_back(static_cast<char>(c - '0'));
+  MappedFile file(filename);
+  bool loaded = false;
+  // Правила Generations считает только GenerationsEngine.
+  if (IsBinaryBoard(file)) {
+    std::string rules;
+    size_t generation = 0;
+    loaded = LoadBinaryBoard(file, field_, rules, generation);
+    Rules loaded_rules = ParseRules(rules);
+    loaded = loaded && loaded_rules.states_ == 2;
+    if (loaded) {
+      rules_ = loaded_rules;
+      iterations_count_ = desired_iterations_count_ = generation;
+    }
+  } else if (IsRleBoard(file)) {
+    std::string rules;
+    loaded = LoadRleBoard(file, field_, rules, h_size, v_size);
+    if (loaded && !rules.empty()) {
+      Rules loaded_rules = ParseRules(rules);
+      loaded = loaded_rules.states_ == 2;
+      rules_ = loaded ? loaded_rules : rules_;
     }
+  } else {
+    loaded = LoadCsvBoard(file, field_, num_threads_);
+  }
+  if (!loaded) {
+    field_.clear();
+    return false;
   }
   new_field_ = field_;
+  CountTiles(field_, population_);
+  new_population_ = population_;
 
   CreateThreads();
 
   return true;
 }
 
+bool GameOfLife::Stream(const std::string& input, const std::string& output,
+                        const size_t generations, const size_t band_rows,
+                        const size_t generations_per_pass) const {
+  // Ядра по биту на клетку считают только окрестность 3 x 3.
+  if (rules_.radius_ > 1) {
+    return false;
+  }
+  StreamingEngine engine(rules_, num_threads_, band_rows,
+                         generations_per_pass);
+  return engine.Run(input, output, generations, RulesString(rules_));
+}
+
+std::vector<SoupResult> GameOfLife::Soup(const size_t count,
+                                         const size_t h_size,
+                                         const size_t v_size,
+                                         const size_t generations,
+                                         const double density,
+                                         const unsigned seed) const {
+  if (rules_.radius_ > 1) {
+    return std::vector<SoupResult>();
+  }
+  SoupEngine engine(rules_, num_threads_);
+  return engine.Run(count, h_size, v_size, generations, density, seed);
+}
+
 bool GameOfLife::Run(const size_t add_iterations) {
+  return RunAsync(add_iterations).valid();
+}
+
+std::future<size_t> GameOfLife::RunAsync(const size_t add_iterations,
+                                         RunCallback on_done,
+                                         RunCallback on_progress,
+                                         const size_t every) {
   status_lock_.ReaderLock();
   if (field_.empty()) {
     status_lock_.ReaderUnlock();
-    return false;
+    return std::future<size_t>();
   }
   if (running_) {
     status_lock_.ReaderUnlock();
-    return false;
+    return std::future<size_t>();
   }
   status_lock_.ReaderUnlock();
 
+  auto task = std::make_unique<RunTask>();
+  // Без итераций запуск заканчивается сразу: иначе главный поток обменял бы
+  // поля, которые никто не считал.
+  if (add_iterations == 0) {
+    status_lock_.ReaderLock();
+    size_t iteration = iterations_count_;
+    status_lock_.ReaderUnlock();
+    if (on_done) {
+      on_done(iteration);
+    }
+    task->done_.set_value(iteration);
+    return task->done_.get_future();
+  }
+  task->on_done_ = std::move(on_done);
+  task->on_progress_ = std::move(on_progress);
+  task->every_ = every;
+  std::future<size_t> done = task->done_.get_future();
+
   status_lock_.WriterLock();
+  // Пока блокировка была отпущена, вычисления мог запустить другой вызов,
+  // например из on_done: его задачу заменять нельзя.
+  if (field_.empty() || running_) {
+    status_lock_.WriterUnlock();
+    return std::future<size_t>();
+  }
+  // После Rewind история продолжается с текущей итерации.
+  if (history_ != nullptr && history_->Last() != iterations_count_) {
+    history_->Truncate(iterations_count_, field_);
+  }
+  task->begin_ = iterations_count_;
+  task_ = std::move(task);
   desired_iterations_count_ += add_iterations;
-  running_ = true;
   {
     std::unique_lock<std::mutex> lock(master_sync_mutex_);
+    running_ = true;
     new_task_received_.notify_one();
   }
   status_lock_.WriterUnlock();
 
+  return done;
+}
+
+bool GameOfLife::Cancel() {
+  status_lock_.WriterLock();
+  if (field_.empty()) {
+    status_lock_.WriterUnlock();
+    return false;
+  }
+  if (running_) {
+    desired_iterations_count_ = iterations_count_ + 1;
+  }
+  status_lock_.WriterUnlock();
+  return true;
+}
+
+bool GameOfLife::Wait() {
+  status_lock_.ReaderLock();
+  if (field_.empty()) {
+    status_lock_.ReaderUnlock();
+    return false;
+  }
+  status_lock_.ReaderUnlock();
+
+  std::unique_lock<std::mutex> lock(master_sync_mutex_);
+  while (running_) {
+    run_finished_.wait(lock);
+  }
   return true;
 }
 
@@ -130,23 +219,115 @@ bool GameOfLife::Stop() {
   }
   status_lock_.ReaderUnlock();
 
-  std::unique_lock<std::mutex> lock(master_sync_mutex_);
   status_lock_.WriterLock();
   desired_iterations_count_ = iterations_count_ + 1;
   status_lock_.WriterUnlock();
+  std::unique_lock<std::mutex> lock(master_sync_mutex_);
   while (running_) {
-    new_task_received_.wait(lock);
+    run_finished_.wait(lock);
+  }
+  return true;
+}
+
+bool GameOfLife::Save(const std::string& filename) {
+  status_lock_.ReaderLock();
+  if (field_.empty() || running_) {
+    status_lock_.ReaderUnlock();
+    return false;
+  }
+  bool saved = SaveBinaryBoard(filename, field_, RulesString(rules_),
+                               iterations_count_);
+  status_lock_.ReaderUnlock();
+  return saved;
+}
+
+bool GameOfLife::Record(const std::string& filename, const size_t every,
+                        const size_t memory_limit) {
+  status_lock_.WriterLock();
+  if (field_.empty() || running_ || recorder_ != nullptr) {
+    status_lock_.WriterUnlock();
+    return false;
+  }
+  recorder_ = std::make_unique<GenerationWriter>(filename, every, memory_limit,
+      field_.size(), field_[0].size(), RulesString(rules_));
+  if (!recorder_->IsOpen()) {
+    recorder_.reset();
+    status_lock_.WriterUnlock();
+    return false;
+  }
+  if (iterations_count_ % recorder_->Every() == 0) {
+    recorder_->PushCopy(iterations_count_, field_);
   }
+  status_lock_.WriterUnlock();
+  return true;
+}
+
+bool GameOfLife::StopRecording() {
+  Stop();
+  status_lock_.WriterLock();
+  std::unique_ptr<GenerationWriter> recorder = std::move(recorder_);
+  status_lock_.WriterUnlock();
+  return recorder != nullptr && recorder->Finish();
+}
+
+bool GameOfLife::Checkpoint(const std::string& filename) {
+  status_lock_.WriterLock();
+  if (field_.empty()) {
+    status_lock_.WriterUnlock();
+    return false;
+  }
+  if (running_) {
+    // Поле заберет главный поток на ближайшем обмене полей.
+    checkpoint_target_ = filename;
+    checkpoint_pending_ = true;
+    status_lock_.WriterUnlock();
+    return true;
+  }
+  FinishCheckpointWrite();
+  checkpoint_buffer_ = field_;
+  StartCheckpointWrite(filename, iterations_count_);
+  status_lock_.WriterUnlock();
   return true;
 }
 
+void GameOfLife::SetAutoCheckpoint(const std::string& filename,
+                                   const size_t every) {
+  status_lock_.WriterLock();
+  auto_checkpoint_file_ = filename;
+  auto_checkpoint_every_ = every;
+  status_lock_.WriterUnlock();
+}
+
+bool GameOfLife::Restore(const std::string& filename) {
+  if (!IsBinaryBoard(MappedFile(filename))) {
+    return false;
+  }
+  return Start(filename);
+}
+
+void GameOfLife::StartCheckpointWrite(const std::string& filename,
+                                      const size_t generation) {
+  checkpoint_thread_ = std::thread([this, filename, generation]() {
+    checkpoint_written_ = SaveBinaryBoardAtomically(
+        filename, checkpoint_buffer_, RulesString(rules_), generation);
+  });
+}
+
+bool GameOfLife::FinishCheckpointWrite() {
+  if (checkpoint_thread_.joinable()) {
+    checkpoint_thread_.join();
+  }
+  return checkpoint_written_;
+}
+
 void GameOfLife::Quit() {
   Stop();
+  StopRecording();
   status_lock_.WriterLock();
   quitting_ = true;
-  running_ = true;
   {
     std::unique_lock<std::mutex> lock(master_sync_mutex_);
+    running_ = true;
     new_task_received_.notify_one();
   }
   status_lock_.WriterUnlock();
@@ -157,10 +338,9 @@ void GameOfLife::Quit() {
   if (master_thread_ != nullptr) {
     master_thread_->join();
   };
-  // Костыли для нормального отображения.
+  FinishCheckpointWrite();
+  std::unique_lock<std::mutex> lock(master_sync_mutex_);
   running_ = false;
-  field_.swap(new_field_);
-  --iterations_count_;
 }
 
 void GameOfLife::PrintField(std::ostream& out) const {
@@ -169,23 +349,199 @@ void GameOfLife::PrintField(std::ostream& out) const {
     return;
   }
 
-  out << "Field:\n\u2554";
-  for (int i = 0; i < field_[0].size(); ++i) {
-    out << "\u2550";
+  out << "Field:\n"
+      << RenderView(field_, population_, 0, 0, field_[0].size(),
+                    field_.size(), 1);
+}
+
+bool GameOfLife::View(const long long x, const long long y, const size_t w,
+                      const size_t h, const size_t zoom,
+                      std::ostream& out) const {
+  if (field_.empty()) {
+    return false;
   }
-  out << "\u2557\n";
-  for (const auto& line : field_) {
-    out << "\u2551";
-    for (const auto& cell : line) {
-      out << (cell ? "\u2588" : "\u2591");
+
+  status_lock_.ReaderLock();
+  if (running_) {
+    status_lock_.ReaderUnlock();
+    return false;
+  }
+  out << RenderView(field_, population_, x, y, w, h, zoom);
+  status_lock_.ReaderUnlock();
+  return true;
+}
+
+bool GameOfLife::Edit(std::vector<CellEdit> edits) {
+  if (field_.empty()) {
+    return false;
+  }
+  // Пока вычисления идут, правки заберет главный поток. Он проверяет
+  // очередь и под status_lock_ при остановке, поэтому правка не потеряется.
+  status_lock_.ReaderLock();
+  if (running_) {
+    edits_.Push(std::move(edits));
+    status_lock_.ReaderUnlock();
+    return true;
+  }
+  status_lock_.ReaderUnlock();
+
+  status_lock_.WriterLock();
+  edits_.Push(std::move(edits));
+  if (!running_) {
+    std::vector<CellEdit> pending;
+    edits_.Drain(pending);
+    // Сводка итерации уже записана, исправленное поле получает свою с тем
+    // же номером итерации, без рождений и смертей.
+    Census edited = census_.Last();
+    edited.births_ = 0;
+    edited.deaths_ = 0;
+    ApplyEdits(pending, field_, population_, edited, false);
+    census_.Add(edited);
+  }
+  status_lock_.WriterUnlock();
+  return true;
+}
+
+void GameOfLife::ApplyEdits(const std::vector<CellEdit>& edits,
+                            CyclicVector<CyclicVector<char>>& field,
+                            TilePopulation& population, Census& census,
+                            const bool next_iteration) {
+  long long height = field.size();
+  std::vector<long long> rows;
+  // Прямоугольник расширяется родившимися клетками. Сузить его может только
+  // клетка, умершая на его границе: тогда он пересчитывается по полю.
+  bool shrunk = false;
+  for (const auto& edit : edits) {
+    long long row = (edit.row_ % height + height) % height;
+    long long width = field[row].size();
+    long long column = (edit.column_ % width + width) % width;
+    char alive = edit.alive_ ? 1 : 0;
+    char& cell = field[row][column];
+    if (cell == alive) {
+      continue;
+    }
+    cell = alive;
+    rows.push_back(row);
+    if (alive) {
+      ++census.population_;
+      census.AddRow(row, column, column);
+    } else {
+      --census.population_;
+      shrunk = shrunk || row == census.min_row_ || row == census.max_row_ ||
+               column == census.min_col_ || column == census.max_col_;
     }
-    out << "\u2551\n";
   }
-  out << "\u255A";
-  for (int i = 0; i < field_[0].size(); ++i) {
-    out << "\u2550";
+  if (shrunk) {
+    Census bounds = CountCensus(field, 0, field.size());
+    census.min_row_ = bounds.min_row_;
+    census.max_row_ = bounds.max_row_;
+    census.min_col_ = bounds.min_col_;
+    census.max_col_ = bounds.max_col_;
+  }
+  std::sort(rows.begin(), rows.end());
+  rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+  for (auto i : rows) {
+    CountTiles(field[i], population[i]);
+  }
+
+  if (history_ == nullptr) {
+    return;
+  }
+  if (next_iteration) {
+    for (auto i : rows) {
+      history_->RepackRow(i, field[i]);
+    }
+    return;
+  }
+  // После Rewind история сначала обрезается до текущей итерации.
+  if (history_->Last() != iterations_count_) {
+    history_->Truncate(iterations_count_, field);
+  }
+  history_->Replace(field);
+}
+
+bool GameOfLife::SetHistory(const size_t memory_limit,
+                            const size_t keyframe_period) {
+  status_lock_.ReaderLock();
+  bool running = running_;
+  status_lock_.ReaderUnlock();
+  if (field_.empty() || running) {
+    return false;
+  }
+
+  // Вычисления остановлены, потоки не трогают history_.
+  if (memory_limit == 0) {
+    history_.reset();
+    return true;
+  }
+  history_ = std::make_unique<History>(memory_limit, keyframe_period,
+                                       field_.size(), field_[0].size());
+  history_->Reset(iterations_count_, field_);
+  return true;
+}
+
+bool GameOfLife::PrintHistory(std::ostream& out) const {
+  if (field_.empty()) {
+    return false;
+  }
+  status_lock_.ReaderLock();
+  bool running = running_;
+  status_lock_.ReaderUnlock();
+  if (running) {
+    return false;
+  }
+  if (history_ == nullptr) {
+    out << "History is off.\n";
+  } else {
+    out << "History keeps iterations " << history_->First() << " to "
+        << history_->Last() << " in "
+        << static_cast<double>(history_->MemoryUsed()) / (1 << 20)
+        << " MB.\n";
   }
-  out << "\u255D\n";
+  return true;
+}
+
+bool GameOfLife::Rewind(const size_t generation) {
+  status_lock_.ReaderLock();
+  bool running = running_;
+  status_lock_.ReaderUnlock();
+  if (field_.empty() || running || history_ == nullptr) {
+    return false;
+  }
+
+  CyclicVector<CyclicVector<char>> field;
+  if (!history_->Restore(generation, rules_, field)) {
+    return false;
+  }
+  status_lock_.WriterLock();
+  field_.swap(field);
+  iterations_count_ = generation;
+  desired_iterations_count_ = generation;
+  CountTiles(field_, population_);
+  Census census = CountCensus(field_, 0, field_.size());
+  census.generation_ = generation;
+  census_.Add(census);
+  status_lock_.WriterUnlock();
+  return true;
+}
+
+bool GameOfLife::QueryRegion(const long long x, const long long y,
+                             const size_t w, const size_t h,
+                             const size_t generations,
+                             CyclicVector<CyclicVector<char>>& region,
+                             size_t& generation) const {
+  if (field_.empty() || w == 0 || h == 0) {
+    return false;
+  }
+
+  // Под блокировкой только копируется конус, считается он без нее.
+  status_lock_.ReaderLock();
+  LightCone cone = CutLightCone(field_, x, y, w, h, generations,
+                                rules_.radius_);
+  generation = iterations_count_ + generations;
+  status_lock_.ReaderUnlock();
+  region = AdvanceLightCone(cone, rules_);
+  return true;
 }
 
 bool GameOfLife::PrintStatus(std::ostream& out) const {
@@ -208,6 +564,151 @@ bool GameOfLife::PrintStatus(std::ostream& out) const {
   return true;
 }
 
+bool GameOfLife::PrintStats(const bool json, std::ostream& out) const {
+  if (stats_.empty()) {
+    out << "No field has been created yet.\n";
+    return false;
+  }
+  status_lock_.ReaderLock();
+  size_t iterations = iterations_count_;
+  status_lock_.ReaderUnlock();
+
+  const char* names[] = {"compute", "barrier", "lock"};
+  const ThreadStats& master = stats_.back();
+  if (json) {
+    out << "{\"iterations\": " << iterations << ", \"threads\": [";
+    for (size_t i = 0; i + 1 < stats_.size(); ++i) {
+      out << (i == 0 ? "\n  {" : ",\n  {");
+      for (int phase = Compute; phase <= LockWait; ++phase) {
+        out << (phase == Compute ? "\"" : ", \"") << names[phase] << "\": ";
+        stats_[i].phases_[phase].PrintJson(out);
+      }
+      out << "}";
+    }
+    out << "],\n \"master\": {\"lock\": ";
+    master.phases_[LockWait].PrintJson(out);
+    out << ", \"sync\": ";
+    master.phases_[Sync].PrintJson(out);
+    out << "}}\n";
+    return true;
+  }
+
+  // Этапы рабочих потоков суммируются.
+  TimeHistogram total[PhasesCount];
+  for (size_t i = 0; i + 1 < stats_.size(); ++i) {
+    for (int phase = Compute; phase <= LockWait; ++phase) {
+      total[phase].Merge(stats_[i].phases_[phase]);
+    }
+  }
+  out << "Iterations: " << iterations << ", threads: " << stats_.size() - 1
+      << ".\n";
+  TimeHistogram::PrintHeader(out);
+  for (int phase = Compute; phase <= LockWait; ++phase) {
+    total[phase].PrintRow(out, names[phase]);
+  }
+  master.phases_[LockWait].PrintRow(out, "master lock");
+  master.phases_[Sync].PrintRow(out, "master sync");
+  out << "Per thread, ms (compute / barrier / lock):\n";
+  auto flags = out.flags();
+  auto precision = out.precision();
+  out << std::fixed << std::setprecision(1);
+  for (size_t i = 0; i + 1 < stats_.size(); ++i) {
+    out << "\t" << i << ": "
+        << stats_[i].phases_[Compute].TotalNanoseconds() / 1e6 << " / "
+        << stats_[i].phases_[Barrier].TotalNanoseconds() / 1e6 << " / "
+        << stats_[i].phases_[LockWait].TotalNanoseconds() / 1e6 << "\n";
+  }
+  out.flags(flags);
+  out.precision(precision);
+  return true;
+}
+
+bool GameOfLife::ResetStats() {
+  status_lock_.ReaderLock();
+  bool running = running_;
+  status_lock_.ReaderUnlock();
+  if (stats_.empty() || running) {
+    return false;
+  }
+  for (auto& stats : stats_) {
+    for (auto& phase : stats.phases_) {
+      phase.Reset();
+    }
+    stats.perf_.Reset();
+  }
+  return true;
+}
+
+bool GameOfLife::PrintCensus(const size_t count, std::ostream& out) const {
+  status_lock_.ReaderLock();
+  if (census_.Empty()) {
+    status_lock_.ReaderUnlock();
+    out << "No field has been created yet.\n";
+    return false;
+  }
+  census_.Print(out, count);
+  status_lock_.ReaderUnlock();
+  return true;
+}
+
+bool GameOfLife::RecordCensus(const std::string& filename) {
+  status_lock_.WriterLock();
+  bool recording = true;
+  if (filename.empty()) {
+    census_.StopRecording();
+  } else {
+    recording = census_.Record(filename);
+  }
+  status_lock_.WriterUnlock();
+  return recording;
+}
+
+void GameOfLife::SetPerfCounters(const bool enabled) {
+  perf_enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+bool GameOfLife::PrintPerf(const bool json, std::ostream& out) const {
+  if (stats_.empty()) {
+    out << "No field has been created yet.\n";
+    return false;
+  }
+  PerfTotals total;
+  CollectPerf(total);
+  if (json) {
+    out << "{\"enabled\": "
+        << (perf_enabled_.load(std::memory_order_relaxed) ? "true" : "false")
+        << ", \"total\": ";
+    total.PrintJson(out);
+    out << ", \"threads\": [";
+    for (size_t i = 0; i + 1 < stats_.size(); ++i) {
+      out << (i == 0 ? "\n  " : ",\n  ");
+      stats_[i].perf_.PrintJson(out);
+    }
+    out << "]}\n";
+    return true;
+  }
+
+  out << "Performance counters are "
+      << (perf_enabled_.load(std::memory_order_relaxed) ? "on" : "off")
+      << ".\n";
+  PerfTotals::PrintHeader(out);
+  total.PrintRow(out, "total");
+  for (size_t i = 0; i + 1 < stats_.size(); ++i) {
+    stats_[i].perf_.PrintRow(out, std::to_string(i));
+  }
+  return true;
+}
+
+bool GameOfLife::CollectPerf(PerfTotals& total) const {
+  if (stats_.empty()) {
+    return false;
+  }
+  for (size_t i = 0; i + 1 < stats_.size(); ++i) {
+    total.Merge(stats_[i].perf_);
+  }
+  return true;
+}
+
 void GameOfLife::CreateThreads() {
   num_threads_ = std::min(num_threads_, field_.size());
   assert(barrier_.ResizeBarrier(num_threads_));
@@ -221,18 +722,45 @@ void GameOfLife::CreateThreads() {
     borders_[i] += borders_[i - 1];
   }
 
+  // Последняя ячейка - главного потока.
+  stats_ = std::vector<ThreadStats>(num_threads_ + 1);
+  part_census_ = std::vector<Census>(num_threads_);
+  Census census = CountCensus(field_, 0, field_.size());
+  census.generation_ = iterations_count_;
+  census_.Add(census);
+
+  // Главный поток запускается, только когда все потоки дошли до барьера:
+  // иначе его разрешение может быть затерто барьером, и Quit сразу после
+  // Start зависнет.
+  permission_ = true;
   for (size_t i = 0; i < num_threads_; ++i) {
     threads_.push_back(std::move(std::thread(&GameOfLife::Synchronize,
         this, i)));
   }
+  {
+    std::unique_lock<std::mutex> lock(sync_mutex_);
+    while (permission_) {
+      all_threads_stopped_.wait(lock);
+    }
+  }
   master_thread_ = std::make_unique<std::thread>(
       &GameOfLife::MasterSynchronize, this);
 }
 
 void GameOfLife::Synchronize(const size_t thread_id) {
+  auto& stats = stats_[thread_id];
+  // Счетчики считают события вызывающего потока, поэтому открываются здесь.
+  std::unique_ptr<PerfCounters> counters;
+  uint64_t cells = static_cast<uint64_t>(borders_[thread_id + 1] -
+                                         borders_[thread_id]) *
+                   field_[0].size();
+  uint64_t before[PerfCounters::EventsCount];
+  uint64_t after[PerfCounters::EventsCount];
   while (true) {
     bool calculate = false;
+    auto lock_begin = TimeHistogram::Clock::now();
     status_lock_.ReaderLock();
+    auto lock_end = TimeHistogram::Clock::now();
     if (quitting_) {
       status_lock_.ReaderUnlock();
       break;
@@ -242,84 +770,220 @@ void GameOfLife::Synchronize(const size_t thread_id) {
     }
     status_lock_.ReaderUnlock();
 
+    // Итерации без вычислений - простой в ожидании команды, они не
+    // учитываются.
     if (calculate) {
+      stats.phases_[LockWait].Add(lock_begin, lock_end);
+      bool perf = perf_enabled_.load(std::memory_order_relaxed);
+      if (perf && !counters) {
+        counters = std::make_unique<PerfCounters>();
+      }
+      bool sampled = perf && counters->Read(before);
+      auto compute_begin = TimeHistogram::Clock::now();
       CalculatePart(thread_id);
+      auto compute_end = TimeHistogram::Clock::now();
+      if (perf) {
+        sampled = counters->Read(after) && sampled;
+      }
+      stats.phases_[Compute].Add(compute_begin, compute_end);
+      if (perf) {
+        // Без счетчиков учитываются только время и число клеток.
+        stats.perf_.Add(sampled ? counters->AvailableMask() : 0, before,
+                        after,
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            compute_end - compute_begin).count(),
+                        cells);
+      }
     }
 
-    barrier_.PassThrough();
+    auto barrier_begin = TimeHistogram::Clock::now();
+    auto all_entered = barrier_.PassThrough();
+    if (calculate) {
+      stats.phases_[Barrier].Add(barrier_begin, all_entered);
+    }
   }
 }
 
 void GameOfLife::CalculatePart(const size_t thread_id) {
-  for (long long i = borders_[thread_id]; i < borders_[thread_id + 1]; ++i) {
-    for (long long j = 0; j < field_[i].size(); ++j) {
-      char num_alive = 0;
-      for (int x = -1; x <= 1; ++x) {
-        for (int y = -1; y <= 1; ++y) {
-          if (x != 0 || y != 0) {
-            num_alive += field_[i + x][j + y];
-          }
-        }
-      }
-
-      if (field_[i][j]) {
-        new_field_[i][j] = 0;
-        for (auto num_to_stay : rules_.stay_) {
-          if (num_alive == num_to_stay) {
-            new_field_[i][j] = 1;
-            break;
-          }
-        }
-      } else {
-        new_field_[i][j] = 0;
-        for (auto num_to_be_born : rules_.born_) {
-          if (num_alive == num_to_be_born) {
-            new_field_[i][j] = 1;
-            break;
-          }
-        }
-      }
-    }
-  }
+  Census census;
+  CalculateRows(field_, new_field_, rules_, borders_[thread_id],
+                borders_[thread_id + 1], 0, census,
+                [this](const long long i, const bool) {
+                  CountTiles(new_field_[i], new_population_[i]);
+                  if (history_ != nullptr) {
+                    history_->PackRow(i, new_field_[i]);
+                  }
+                });
+  part_census_[thread_id] = census;
 }
 
 void GameOfLife::MasterSynchronize() {
+  auto& stats = stats_[num_threads_];
+  // Время от прихода всех потоков на барьер до их освобождения, без
+  // ожидания новых итераций.
+  auto sync_begin = TimeHistogram::Clock::now();
+  bool sync_started = false;
   while (true) {
     status_lock_.ReaderLock();
     if (quitting_) {
       status_lock_.ReaderUnlock();
+      // Потоки ждут на барьере, отпускаем их к выходу.
+      std::unique_lock<std::mutex> lock(sync_mutex_);
+      permission_ = true;
+      all_threads_stopped_.notify_one();
       return;
     }
+    status_lock_.ReaderUnlock();
     {
+      // running_ меняется только под master_sync_mutex_, status_lock_ для
+      // ожидания не нужен.
       std::unique_lock<std::mutex> outer_lock(master_sync_mutex_);
-      new_task_received_.notify_one();
+      if (sync_started && !running_) {
+        stats.phases_[Sync].AddSince(sync_begin);
+        sync_started = false;
+      }
       while (!running_) {
-        status_lock_.ReaderUnlock();
         new_task_received_.wait(outer_lock);
-        status_lock_.ReaderLock();
       }
     }
-    status_lock_.ReaderUnlock();
 
     {
       std::unique_lock<std::mutex> lock(sync_mutex_);
       permission_ = true;
       all_threads_stopped_.notify_one();
+      if (sync_started) {
+        stats.phases_[Sync].AddSince(sync_begin);
+      }
       status_lock_.ReaderLock();
       while (permission_ && !quitting_) {
         status_lock_.ReaderUnlock();
         all_threads_stopped_.wait(lock);
         status_lock_.ReaderLock();
       }
+      bool quitting = quitting_;
       status_lock_.ReaderUnlock();
+      if (quitting) {
+        return;
+      }
+      sync_begin = TimeHistogram::Clock::now();
+      sync_started = true;
+    }
+
+    // Поле, ушедшее в запись или контрольную точку, заменяется свободным
+    // буфером. Его содержимое все равно будет перезаписано на следующей
+    // итерации.
+    auto lock_begin = TimeHistogram::Clock::now();
+    status_lock_.ReaderLock();
+    stats.phases_[LockWait].AddSince(lock_begin);
+    bool record = record_pending_;
+    bool checkpoint = checkpoint_pending_;
+    status_lock_.ReaderUnlock();
+    CyclicVector<CyclicVector<char>> spare;
+    if (record) {
+      recorder_->AcquireBuffer(spare);
+    }
+    if (checkpoint) {
+      // Ждем, только если предыдущая контрольная точка еще пишется.
+      FinishCheckpointWrite();
+      if (checkpoint_buffer_.empty()) {
+        checkpoint_buffer_ = field_;
+      }
+    }
+
+    // Потоки стоят на барьере, их сводки и строки истории не меняются.
+    Census census;
+    for (const auto& part : part_census_) {
+      census.Merge(part);
+    }
+    // Правки ложатся на следующую итерацию до того, как она станет
+    // текущей, поэтому читатели их никогда не видят наполовину.
+    if (edits_.Drain(drained_edits_)) {
+      ApplyEdits(drained_edits_, new_field_, new_population_, census, true);
+    }
+    if (history_ != nullptr) {
+      history_->Commit();
     }
 
+    lock_begin = TimeHistogram::Clock::now();
     status_lock_.WriterLock();
+    stats.phases_[LockWait].AddSince(lock_begin);
     field_.swap(new_field_);
+    population_.swap(new_population_);
+    if (checkpoint) {
+      new_field_.swap(checkpoint_buffer_);
+    }
+    if (record) {
+      if (checkpoint) {
+        for (size_t i = 0; i < spare.size(); ++i) {
+          std::copy(checkpoint_buffer_[i].begin(), checkpoint_buffer_[i].end(),
+                    spare[i].begin());
+        }
+      } else {
+        new_field_.swap(spare);
+      }
+      recorder_->Push(iterations_count_, spare);
+      record_pending_ = false;
+    }
+    if (checkpoint) {
+      StartCheckpointWrite(checkpoint_target_, iterations_count_);
+      checkpoint_pending_ = false;
+    }
     ++iterations_count_;
     if (iterations_count_ >= desired_iterations_count_) {
-      running_ = false;
+      {
+        std::unique_lock<std::mutex> lock(master_sync_mutex_);
+        running_ = false;
+        run_finished_.notify_all();
+      }
+      // Правки, пришедшие после последнего обмена полей. Сводка итерации
+      // еще не записана и считается уже по исправленному полю.
+      if (edits_.Drain(drained_edits_)) {
+        ApplyEdits(drained_edits_, field_, population_, census, false);
+      }
+    }
+    census.generation_ = iterations_count_;
+    census_.Add(census);
+    if (recorder_ != nullptr &&
+        iterations_count_ % recorder_->Every() == 0) {
+      if (running_) {
+        record_pending_ = true;
+      } else {
+        recorder_->PushCopy(iterations_count_, field_);
+      }
+    }
+    if (auto_checkpoint_every_ != 0 &&
+        iterations_count_ % auto_checkpoint_every_ == 0) {
+      checkpoint_target_ = auto_checkpoint_file_;
+      checkpoint_pending_ = true;
+    }
+    // После остановки обмена полей не будет, поле копируется.
+    if (checkpoint_pending_ && !running_) {
+      FinishCheckpointWrite();
+      checkpoint_buffer_ = field_;
+      StartCheckpointWrite(checkpoint_target_, iterations_count_);
+      checkpoint_pending_ = false;
+    }
+    // Обратные вызовы выполняются после снятия блокировки. Пока идут
+    // вычисления, task_ никто, кроме главного потока, не меняет.
+    size_t iteration = iterations_count_;
+    RunTask* task = task_.get();
+    std::unique_ptr<RunTask> finished;
+    if (!running_) {
+      finished = std::move(task_);
     }
     status_lock_.WriterUnlock();
+
+    if (task != nullptr) {
+      if (task->on_progress_ && task->every_ != 0 &&
+          (iteration - task->begin_) % task->every_ == 0) {
+        task->on_progress_(iteration);
+      }
+      if (finished != nullptr) {
+        if (finished->on_done_) {
+          finished->on_done_(iteration);
+        }
+        finished->done_.set_value(iteration);
+      }
+    }
   }
 }
\ No newline at end of file
@@ -1,45 +1,235 @@
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
+#include <functional>
+#include <future>
 #include <mutex>
 #include <thread>
 
 #include <vector>
 
 #include "multithreading_utils.hpp"
+#include "census.hpp"
 #include "cyclic_vector.hpp"
+#include "edits.hpp"
+#include "engine.hpp"
+#include "field_view.hpp"
+#include "generation_writer.hpp"
+#include "history.hpp"
+#include "light_cone.hpp"
+#include "perf_counters.hpp"
+#include "rules.hpp"
+#include "soup_engine.hpp"
+#include "time_histogram.hpp"
+
+class GameOfLife : public Engine {
+ public:
+  // Обратный вызов с номером итерации.
+  using RunCallback = std::function<void(size_t)>;
 
-class GameOfLife {
  public:
   // Конструктор от числа потоков и правил игры.
   explicit GameOfLife(const size_t num_threads = 4,
                       const std::string& rules = "b3/s23");
 
-  // Создание поля h_size x v_size с рандомными значениями.
-  bool Start(const size_t h_size, const size_t v_size);
+  // Создание поля h_size x v_size с рандомными значениями: клетка жива с
+  // вероятностью density, поле определяется зерном seed.
+  bool Start(const size_t h_size, const size_t v_size, const double density,
+             const unsigned seed);
+
+  // То же с вероятностью 0.5 и зерном 1337.
+  bool Start(const size_t h_size, const size_t v_size) override {
+    return Start(h_size, v_size, 0.5, 1337);
+  }
+
+  // Загрузка поля из .csv файла, паттерна RLE или двоичного файла поля. Из
+  // двоичного файла восстанавливаются также правила и номер итерации, из
+  // RLE - правила, если они указаны. Паттерн RLE помещается в центр поля
+  // размера не меньше h_size x v_size.
+  bool Start(const std::string& filename, const size_t h_size = 0,
+             const size_t v_size = 0) override;
+
+  // Сохранение поля в двоичный файл. Возможно только при остановленных
+  // вычислениях.
+  bool Save(const std::string& filename) override;
+
+  // Запись каждой every-й итерации в файл фоновым потоком. Очередь записи
+  // занимает не больше memory_limit байт, при ее заполнении вычисления ждут
+  // запись. Возможно только при остановленных вычислениях.
+  bool Record(const std::string& filename, const size_t every,
+              const size_t memory_limit);
+
+  // Остановка вычислений и завершение записи итераций. Возвращает false,
+  // если записи не было или файл не удалось записать.
+  bool StopRecording();
+
+  // Контрольная точка: поле с правилами и номером итерации записывается в
+  // двоичный файл фоновым потоком, вычисления при этом продолжаются. Во
+  // время вычислений сохраняется ближайшая итерация.
+  bool Checkpoint(const std::string& filename);
+
+  // Автоматическая контрольная точка в filename на каждой every-й итерации.
+  // При every = 0 автоматические контрольные точки отключаются.
+  void SetAutoCheckpoint(const std::string& filename, const size_t every);
+
+  // Восстановление поля из контрольной точки или файла, сохраненного Save.
+  bool Restore(const std::string& filename);
+
+  // Расчет generations итераций поля из двоичного файла input без загрузки
+  // в память: поле проходит через память полосами по band_rows строк, за
+  // проход по файлу выполняется generations_per_pass итераций. Результат
+  // пишется в output. Поле игры и идущие вычисления не затрагиваются.
+  // Только для правил с радиусом окрестности 1.
+  bool Stream(const std::string& input, const std::string& output,
+              const size_t generations, const size_t band_rows,
+              const size_t generations_per_pass) const;
 
-  // Загрузка поля из .csv файла.
-  bool Start(const std::string& filename);
+  // Расчет count независимых случайных полей h_size x v_size (см.
+  // SoupEngine) не дольше generations итераций каждое. Поле игры и идущие
+  // вычисления не затрагиваются. Для правил с радиусом окрестности больше 1
+  // результат пуст.
+  std::vector<SoupResult> Soup(const size_t count, const size_t h_size,
+                               const size_t v_size, const size_t generations,
+                               const double density,
+                               const unsigned seed) const;
 
   // Запуск процесса выполнения нескольких итераций перерасчета поля.
-  bool Run(const size_t num_iterations);
+  bool Run(const size_t num_iterations) override;
+
+  // Запуск, как Run. future получает номер итерации, на которой вычисления
+  // закончились, в том числе после Stop или Cancel; on_done вызывается с
+  // ним же, on_progress - после каждой every-й итерации запуска. Обратные
+  // вызовы выполняет главный поток вне блокировок: в них можно вызывать
+  // RunAsync, Cancel и вывод, но не Wait, Stop и Quit. Если запустить
+  // нельзя, у future нет состояния (valid() == false). Запуск без итераций
+  // заканчивается сразу, on_done вызывается в вызывающем потоке.
+  std::future<size_t> RunAsync(const size_t num_iterations,
+                               RunCallback on_done = nullptr,
+                               RunCallback on_progress = nullptr,
+                               const size_t every = 0);
+
+  // Остановка вычислений без ожидания: они закончатся на следующей
+  // итерации. Возвращает false, если поля нет.
+  bool Cancel();
+
+  // Ожидание окончания запущенных итераций.
+  bool Wait() override;
 
   // Досрочная остановка вычислений.
   bool Stop();
 
   // Остановка всех вычислений и завершение потоков.
-  void Quit();
+  void Quit() override;
 
   // Вывод всего поля. Можно использовать только когда заранее известно,
   // что все потоки остановлены.
   void PrintField(std::ostream& out = std::cout) const;
 
+  // Вывод окна из w x h клеток с левым верхним углом в столбце x строки y,
+  // при zoom > 1 - блоками zoom x zoom клеток. Возвращает false, если поля
+  // нет или вычисления идут.
+  bool View(const long long x, const long long y, const size_t w,
+            const size_t h, const size_t zoom,
+            std::ostream& out = std::cout) const;
+
+  // Правка клеток без остановки вычислений. Правки ставятся в очередь и
+  // применяются главным потоком к следующей итерации при обмене полей, а
+  // если вычисления остановлены - сразу к текущей. Правка остановленного
+  // поля добавляет в сводки строку с тем же номером итерации.
+  bool Edit(std::vector<CellEdit> edits);
+
+  // Хранение истории следующих итераций в памяти: ключевой кадр каждые
+  // keyframe_period итераций и разности между ними, не больше memory_limit
+  // байт (см. History). История начинается с текущей итерации. При
+  // memory_limit = 0 история выключается. Только при остановленных
+  // вычислениях.
+  bool SetHistory(const size_t memory_limit, const size_t keyframe_period);
+
+  // Вывод итераций, хранимых историей, и занятой ею памяти.
+  bool PrintHistory(std::ostream& out = std::cout) const;
+
+  // Возврат поля к итерации generation из истории. Итерации после нее
+  // остаются в истории до следующего запуска. Только при остановленных
+  // вычислениях.
+  bool Rewind(const size_t generation);
+
+  // Состояние окна w x h с левым верхним углом в столбце x строки y через
+  // generations итераций после текущей. Считается только световой конус
+  // окна, поле и идущие вычисления не затрагиваются. В generation
+  // записывается итерация, которой соответствует region.
+  bool QueryRegion(const long long x, const long long y, const size_t w,
+                   const size_t h, const size_t generations,
+                   CyclicVector<CyclicVector<char>>& region,
+                   size_t& generation) const;
+
+  // Время этапов итерации по потокам: вычисления, ожидание остальных на
+  // барьере, ожидание status_lock_ и работа главного потока между
+  // итерациями. Таблицей или в JSON.
+  bool PrintStats(const bool json, std::ostream& out = std::cout) const;
+
+  // Сброс времени этапов и счетчиков производительности. Только при
+  // остановленных вычислениях.
+  bool ResetStats();
+
+  // Включение счетчиков производительности процессора вокруг CalculatePart.
+  // Каждый поток открывает свои счетчики при первой итерации после
+  // включения. Недоступные счетчики (например, в контейнере) не мешают
+  // вычислениям и выводятся как n/a.
+  void SetPerfCounters(const bool enabled);
+
+  // Счетчики производительности по потокам вместе с обновлениями клеток в
+  // секунду. Таблицей или в JSON.
+  bool PrintPerf(const bool json, std::ostream& out = std::cout) const;
+
+  // Прибавление счетчиков всех потоков к total.
+  bool CollectPerf(PerfTotals& total) const;
+
+  // Вывод сводок (население, рождения, смерти, ограничивающий
+  // прямоугольник) последних count итераций.
+  bool PrintCensus(const size_t count, std::ostream& out = std::cout) const;
+
+  // Запись сводки каждой следующей итерации в файл CSV. При пустом filename
+  // запись прекращается.
+  bool RecordCensus(const std::string& filename) override;
+
   // Состояние класса. В случае бездействия потоков возвращает true.
   bool PrintStatus(std::ostream& out = std::cout) const;
 
  private:
   void CreateThreads();
 
+  // Запуск фоновой записи checkpoint_buffer_ в контрольную точку.
+  void StartCheckpointWrite(const std::string& filename,
+                            const size_t generation);
+
+  // Ожидание окончания фоновой записи контрольной точки. Возвращает false,
+  // если запись не удалась.
+  bool FinishCheckpointWrite();
+
+  // Этапы итерации, время которых замеряется.
+  enum Phase {
+    Compute,   // CalculatePart.
+    Barrier,   // Ожидание остальных потоков на барьере.
+    LockWait,  // Ожидание status_lock_.
+    Sync,      // Главный поток: от прихода всех на барьер до их выпуска.
+    PhasesCount
+  };
+
+  // Запуск, ожидающий окончания.
+  struct RunTask {
+    std::promise<size_t> done_;
+    RunCallback on_done_;
+    RunCallback on_progress_;
+    size_t every_;
+    size_t begin_;  // Итерация запуска.
+  };
+
+  struct ThreadStats {
+    TimeHistogram phases_[PhasesCount];
+    PerfTotals perf_;  // Только у рабочих потоков.
+  };
+
   // Функции, которые будут выполняться потоками.
 
   // Процесс синхронизации между потоками.
@@ -51,6 +241,16 @@ class GameOfLife {
   // Операция потока, отвечающего за обновление статуса всей игры.
   void MasterSynchronize();
 
+  // Применение правок к полю field с населением плиток population. Для
+  // next_iteration поле - следующая итерация, еще не добавленная в историю,
+  // иначе - текущая. Сводка поля census исправляется на изменившиеся
+  // клетки, рождения и смерти итерации не меняются. Вызывается, когда
+  // потоки не трогают поле.
+  void ApplyEdits(const std::vector<CellEdit>& edits,
+                  CyclicVector<CyclicVector<char>>& field,
+                  TilePopulation& population, Census& census,
+                  const bool next_iteration);
+
  private:
   CyclicVector<CyclicVector<char>> field_;
   CyclicVector<CyclicVector<char>> new_field_;
@@ -63,20 +263,57 @@ class GameOfLife {
   mutable ReaderWriterLock status_lock_;   // Отвечает за статус игры.
   size_t iterations_count_;
   size_t desired_iterations_count_;
+  // Текущий запуск. Меняется RunAsync при остановленных вычислениях и
+  // главным потоком.
+  std::unique_ptr<RunTask> task_;
   bool running_;
   bool quitting_;
 
   size_t num_threads_;  // Число потоков, работающих с полем.
   std::vector<long long> borders_;  // Границы участков поля для потоков.
   std::vector<std::thread> threads_;  // "Рабы на плантации".
+  // Время этапов каждого потока, последний элемент - главного потока. Пишет
+  // в элемент только его поток.
+  std::vector<ThreadStats> stats_;
+  // Сводки участков потоков за последнюю итерацию, главный поток суммирует
+  // их при обмене полей.
+  std::vector<Census> part_census_;
+  CensusLog census_;
+  std::atomic<bool> perf_enabled_;
   std::unique_ptr<std::thread> master_thread_;   // "Надсмотрщик".
   // Синхронизирует работу главного потока с поступающими сообщениями.
+  // running_ меняется под status_lock_ и master_sync_mutex_ вместе, читать
+  // его можно под любым из них. new_task_received_ ждет только главный
+  // поток, run_finished_ - Wait и Stop.
   std::mutex master_sync_mutex_;
   std::condition_variable new_task_received_;
+  std::condition_variable run_finished_;
+
+  // Население плиток field_ и new_field_.
+  TilePopulation population_;
+  TilePopulation new_population_;
 
-  struct Rules {  // Правила игры. Числа окружающих живых ячеек, при которых
-    std::vector<char> born_;  // ячейка рождается,
-    std::vector<char> stay_;  // ячейка остается жить.
-  };
   Rules rules_;
+
+  std::unique_ptr<GenerationWriter> recorder_;  // Запись итераций в файл.
+  // Правки, ждущие обмена полей.
+  EditQueue edits_;
+  std::vector<CellEdit> drained_edits_;  // Буфер главного потока.
+
+  // История итераций. Потоки упаковывают в нее свои строки, главный поток
+  // добавляет итерацию при обмене полей.
+  std::unique_ptr<History> history_;
+  // Текущее поле должно уйти в запись при следующем обмене полей.
+  bool record_pending_;
+
+  std::string auto_checkpoint_file_;
+  size_t auto_checkpoint_every_;  // 0, если автоматических точек нет.
+  // Текущее поле должно уйти в контрольную точку checkpoint_target_ при
+  // следующем обмене полей.
+  bool checkpoint_pending_;
+  std::string checkpoint_target_;
+  // Поле контрольной точки, которое пишет checkpoint_thread_.
+  CyclicVector<CyclicVector<char>> checkpoint_buffer_;
+  std::thread checkpoint_thread_;
+  bool checkpoint_written_;  // Результат последней записи.
 };
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <cstring>
+
+#include "generation_writer.hpp"
+#include "zero_runs.hpp"
+
+const char kRecordMagic[4] = {'G', 'O', 'L', 'R'};
+const uint32_t kRecordVersion = 1;
+// Каждый kKeyframePeriod-й кадр записывается целиком, чтобы файл можно было
+// читать не с начала.
+const size_t kKeyframePeriod = 32;
+
+GenerationWriter::GenerationWriter(const std::string& filename,
+                                   const size_t every,
+                                   const size_t memory_limit,
+                                   const size_t height, const size_t width,
+                                   const std::string& rules)
+    : out_(filename, std::ios::binary | std::ios::trunc),
+      every_(std::max<size_t>(every, 1)),
+      memory_limit_(memory_limit),
+      height_(height),
+      width_(width),
+      buffers_count_(0),
+      finishing_(false),
+      frames_count_(0) {
+  if (!out_) {
+    return;
+  }
+
+  RecordHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic_, kRecordMagic, sizeof(kRecordMagic));
+  header.version_ = kRecordVersion;
+  header.height_ = height_;
+  header.width_ = width_;
+  header.every_ = every_;
+  header.keyframe_period_ = kKeyframePeriod;
+  std::strncpy(header.rules_, rules.c_str(), sizeof(header.rules_) - 1);
+  out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  thread_ = std::thread(&GenerationWriter::WriterLoop, this);
+}
+
+GenerationWriter::~GenerationWriter() {
+  Finish();
+}
+
+void GenerationWriter::AcquireBuffer(Field& buffer) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Хотя бы один буфер выделяется всегда, иначе писатель не сдвинется.
+  while (free_buffers_.empty() && buffers_count_ > 0 &&
+         (buffers_count_ + 1) * height_ * width_ > memory_limit_) {
+    queue_changed_.wait(lock);
+  }
+  if (!free_buffers_.empty()) {
+    buffer.swap(free_buffers_.back());
+    free_buffers_.pop_back();
+    return;
+  }
+  ++buffers_count_;
+  lock.unlock();
+
+  buffer.assign(height_, CyclicVector<char>());
+  for (auto& line : buffer) {
+    line.assign(width_, 0);
+  }
+}
+
+void GenerationWriter::Push(const size_t generation, Field& field) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  queue_.emplace_back(generation, Field());
+  queue_.back().second.swap(field);
+  queue_changed_.notify_all();
+}
+
+void GenerationWriter::PushCopy(const size_t generation, const Field& field) {
+  Field buffer;
+  AcquireBuffer(buffer);
+  for (size_t i = 0; i < height_; ++i) {
+    std::copy(field[i].begin(), field[i].end(), buffer[i].begin());
+  }
+  Push(generation, buffer);
+}
+
+bool GenerationWriter::Finish() {
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      finishing_ = true;
+      queue_changed_.notify_all();
+    }
+    thread_.join();
+    out_.close();
+  }
+  return static_cast<bool>(out_);
+}
+
+void GenerationWriter::WriterLoop() {
+  const size_t row_size = (width_ + 7) / 8;
+
+  while (true) {
+    size_t generation = 0;
+    Field field;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (queue_.empty() && !finishing_) {
+        queue_changed_.wait(lock);
+      }
+      if (queue_.empty()) {
+        return;
+      }
+      generation = queue_.front().first;
+      field.swap(queue_.front().second);
+      queue_.pop_front();
+    }
+
+    // Буфер возвращается сразу после упаковки, сжатие и запись идут уже
+    // без него.
+    packed_.assign(height_ * row_size, 0);
+    for (size_t i = 0; i < height_; ++i) {
+      unsigned char* row = packed_.data() + i * row_size;
+      const char* cells = field[i].data();
+      for (size_t j = 0; j < width_; ++j) {
+        row[j / 8] |= static_cast<unsigned char>((cells[j] & 1) << (j % 8));
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      free_buffers_.push_back(std::move(field));
+      queue_changed_.notify_all();
+    }
+
+    WriteFrame(generation);
+  }
+}
+
+void GenerationWriter::WriteFrame(const size_t generation) {
+  FrameHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.generation_ = generation;
+  header.type_ = frames_count_ % kKeyframePeriod == 0 ? FrameHeader::Key
+                                                      : FrameHeader::Delta;
+  ++frames_count_;
+
+  if (header.type_ == FrameHeader::Delta) {
+    delta_.resize(packed_.size());
+    for (size_t i = 0; i < packed_.size(); ++i) {
+      delta_[i] = packed_[i] ^ previous_[i];
+    }
+    EncodeZeroRuns(delta_, encoded_);
+  } else {
+    EncodeZeroRuns(packed_, encoded_);
+  }
+  previous_.swap(packed_);
+
+  header.size_ = encoded_.size();
+  out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out_.write(reinterpret_cast<const char*>(encoded_.data()), encoded_.size());
+}
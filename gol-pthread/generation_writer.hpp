@@ -0,0 +1,109 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include <deque>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cyclic_vector.hpp"
+
+// Заголовок файла записи поколений. За ним следуют кадры.
+struct RecordHeader {
+  char magic_[4];             // "GOLR"
+  uint32_t version_;
+  uint64_t height_;
+  uint64_t width_;
+  uint64_t every_;            // Записывается каждая every_-я итерация.
+  uint64_t keyframe_period_;  // Каждый keyframe_period_-й кадр ключевой.
+  char rules_[32];
+};
+
+// Заголовок кадра. Данные кадра - поле по биту на клетку (как в двоичном
+// файле поля) у ключевого кадра или XOR с предыдущим кадром у разностного.
+// Данные сжаты по сериям нулевых байт: пары varint (длина серии нулей,
+// число следующих ненулевых байт), за каждой парой идут сами байты.
+struct FrameHeader {
+  enum Type : uint32_t {
+    Key,
+    Delta
+  };
+
+  uint64_t generation_;
+  uint32_t type_;
+  uint32_t reserved_;
+  uint64_t size_;             // Размер сжатых данных кадра.
+};
+
+// Фоновая запись поколений поля. Поколения передаются писателю обменом
+// буферов, поэтому считающие потоки не ждут диск, пока очередь писателя
+// укладывается в лимит памяти.
+class GenerationWriter {
+ public:
+  using Field = CyclicVector<CyclicVector<char>>;
+
+ public:
+  GenerationWriter(const std::string& filename, const size_t every,
+                   const size_t memory_limit, const size_t height,
+                   const size_t width, const std::string& rules);
+
+  ~GenerationWriter();
+
+  GenerationWriter(const GenerationWriter&) = delete;
+  GenerationWriter& operator=(const GenerationWriter&) = delete;
+
+  bool IsOpen() const {
+    return thread_.joinable();
+  }
+
+  size_t Every() const {
+    return every_;
+  }
+
+  // Выдает буфер размера поля взамен отданного писателю. Ждет, только если
+  // новый буфер не помещается в лимит памяти.
+  void AcquireBuffer(Field& buffer);
+
+  // Передает поле писателю, забирая его содержимое без копирования. Взамен
+  // в field остается пустое поле.
+  void Push(const size_t generation, Field& field);
+
+  // Передает писателю копию поля.
+  void PushCopy(const size_t generation, const Field& field);
+
+  // Дописывает очередь и закрывает файл. Возвращает false при ошибке записи.
+  bool Finish();
+
+ private:
+  // Операция потока писателя.
+  void WriterLoop();
+
+  void WriteFrame(const size_t generation);
+
+ private:
+  std::ofstream out_;
+  size_t every_;
+  size_t memory_limit_;
+  size_t height_;
+  size_t width_;
+
+  std::mutex mutex_;
+  std::condition_variable queue_changed_;
+  std::deque<std::pair<size_t, Field>> queue_;
+  std::vector<Field> free_buffers_;
+  size_t buffers_count_;  // Число выделенных буферов, включая очередь.
+  bool finishing_;
+  std::thread thread_;
+
+  // Состояние потока писателя.
+  size_t frames_count_;
+  std::vector<unsigned char> packed_;
+  std::vector<unsigned char> previous_;  // Предыдущий кадр по биту на клетку.
+  std::vector<unsigned char> delta_;
+  std::vector<unsigned char> encoded_;
+};
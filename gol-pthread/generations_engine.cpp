@@ -0,0 +1,404 @@
+#include <algorithm>
+#include <functional>
+#include <random>
+
+#include "bit_slice.hpp"
+#include "field_io.hpp"
+#include "generations_engine.hpp"
+
+namespace {
+
+const size_t kWordBits = 64;
+
+}  // namespace
+
+GenerationsEngine::GenerationsEngine(const size_t num_threads,
+                                     const std::string& rules)
+    : num_threads_(std::max<size_t>(num_threads, 1)),
+      height_(0),
+      width_(0),
+      words_(0),
+      planes_(1),
+      last_word_mask_(0),
+      generation_(0),
+      stop_(false),
+      permission_(false),
+      stepping_(false),
+      barrier_(num_threads_, sync_mutex_, all_threads_stopped_,
+               permission_) {
+  if (!SetRules(ParseRules(rules))) {
+    SetRules(ParseRules("b3/s23"));
+  }
+}
+
+GenerationsEngine::~GenerationsEngine() {
+  Quit();
+}
+
+bool GenerationsEngine::SetRules(const Rules& rules) {
+  if (rules.radius_ > 1) {
+    return false;
+  }
+  rules_ = rules;
+  counts_.clear();
+  for (int n = 0; n <= 8; ++n) {
+    if (rules.next_[0][n] || rules.next_[1][n]) {
+      counts_.push_back(n);
+    }
+  }
+  planes_ = 1;
+  while ((size_t(1) << planes_) < static_cast<size_t>(rules.states_)) {
+    ++planes_;
+  }
+  return true;
+}
+
+bool GenerationsEngine::Start(const size_t h_size, const size_t v_size) {
+  if (!field_.empty() || h_size == 0 || v_size == 0) {
+    return false;
+  }
+  // Клетки заполняются в том же порядке, что и в GameOfLife::Start.
+  std::mt19937 rng(1337);
+  std::bernoulli_distribution bern(0.5);
+  CyclicVector<CyclicVector<char>> field;
+  field.assign(h_size, CyclicVector<char>());
+  for (auto& line : field) {
+    for (size_t j = 0; j < v_size; ++j) {
+      line.push_back(bern(rng));
+    }
+  }
+  return Load(field);
+}
+
+bool GenerationsEngine::Start(const std::string& filename,
+                              const size_t h_size, const size_t v_size) {
+  if (!field_.empty()) {
+    return false;
+  }
+  MappedFile file(filename);
+  CyclicVector<CyclicVector<char>> field;
+  std::string rules;
+  bool loaded = false;
+  if (IsBinaryBoard(file)) {
+    loaded = LoadBinaryBoard(file, field, rules, generation_);
+  } else if (IsRleBoard(file)) {
+    loaded = LoadRleBoard(file, field, rules, h_size, v_size);
+  } else {
+    loaded = LoadCsvBoard(file, field, num_threads_);
+  }
+  if (!loaded || field.empty() || field[0].empty() ||
+      (!rules.empty() && !SetRules(ParseRules(rules)))) {
+    generation_ = 0;
+    return false;
+  }
+  return Load(field);
+}
+
+bool GenerationsEngine::Load(const CyclicVector<CyclicVector<char>>& field) {
+  height_ = field.size();
+  width_ = field[0].size();
+  words_ = (width_ + kWordBits - 1) / kWordBits;
+  last_word_mask_ = width_ % kWordBits == 0
+                        ? ~uint64_t(0)
+                        : (uint64_t(1) << (width_ % kWordBits)) - 1;
+  field_.assign(height_ * planes_ * words_, 0);
+  new_field_.assign(field_.size(), 0);
+  for (size_t i = 0; i < height_; ++i) {
+    if (field[i].size() != width_) {
+      field_.clear();
+      new_field_.clear();
+      return false;
+    }
+    const char* cells = field[i].data();
+    for (size_t j = 0; j < width_; ++j) {
+      unsigned state = static_cast<unsigned char>(cells[j]);
+      if (state >= static_cast<unsigned>(rules_.states_)) {
+        state = 0;
+      }
+      for (size_t plane = 0; plane < planes_; ++plane) {
+        Plane(field_, i, plane)[j / kWordBits] |=
+            uint64_t((state >> plane) & 1) << (j % kWordBits);
+      }
+    }
+  }
+  workspaces_.assign(num_threads_, Workspace());
+  for (auto& workspace : workspaces_) {
+    for (int slot = 0; slot < 3; ++slot) {
+      workspace.alive_[slot].resize(words_);
+      workspace.sum0_[slot].resize(words_);
+      workspace.sum1_[slot].resize(words_);
+    }
+  }
+
+  Census census;
+  for (size_t i = 0; i < height_; ++i) {
+    long long first = -1;
+    long long last = -1;
+    for (size_t word = 0; word < words_; ++word) {
+      uint64_t alive = Alive(field_, i, word);
+      if (alive == 0) {
+        continue;
+      }
+      census.population_ += __builtin_popcountll(alive);
+      long long base = static_cast<long long>(word * kWordBits);
+      first = first < 0 ? base + __builtin_ctzll(alive) : first;
+      last = base + 63 - __builtin_clzll(alive);
+    }
+    if (first >= 0) {
+      census.AddRow(i, first, last);
+    }
+  }
+  census.generation_ = generation_;
+  census_.Add(census);
+  return true;
+}
+
+uint64_t GenerationsEngine::Alive(const std::vector<uint64_t>& field,
+                                  const size_t i, const size_t word) const {
+  uint64_t alive = Plane(field, i, 0)[word];
+  for (size_t plane = 1; plane < planes_; ++plane) {
+    alive &= ~Plane(field, i, plane)[word];
+  }
+  return alive;
+}
+
+bool GenerationsEngine::Run(const size_t num_iterations) {
+  if (field_.empty() || runner_.joinable()) {
+    return false;
+  }
+  stop_ = false;
+  runner_ = std::thread(&GenerationsEngine::RunIterations, this,
+                        num_iterations);
+  return true;
+}
+
+bool GenerationsEngine::Wait() {
+  if (!runner_.joinable()) {
+    return false;
+  }
+  runner_.join();
+  return true;
+}
+
+bool GenerationsEngine::Save(const std::string& filename) {
+  if (field_.empty() || runner_.joinable()) {
+    return false;
+  }
+  CyclicVector<CyclicVector<char>> field;
+  field.assign(height_, CyclicVector<char>());
+  for (size_t i = 0; i < height_; ++i) {
+    field[i].assign(width_, 0);
+    char* cells = field[i].data();
+    for (size_t plane = 0; plane < planes_; ++plane) {
+      const uint64_t* bits = Plane(field_, i, plane);
+      for (size_t j = 0; j < width_; ++j) {
+        unsigned bit = (bits[j / kWordBits] >> (j % kWordBits)) & 1;
+        cells[j] = static_cast<char>(static_cast<unsigned char>(cells[j]) |
+                                     (bit << plane));
+      }
+    }
+  }
+  return SaveBinaryBoard(filename, field, RulesString(rules_), generation_,
+                         false);
+}
+
+bool GenerationsEngine::RecordCensus(const std::string& filename) {
+  if (runner_.joinable()) {
+    return false;
+  }
+  if (filename.empty()) {
+    census_.StopRecording();
+    return true;
+  }
+  return census_.Record(filename);
+}
+
+void GenerationsEngine::Quit() {
+  stop_ = true;
+  Wait();
+  census_.StopRecording();
+}
+
+void GenerationsEngine::RunIterations(const size_t num_iterations) {
+  if (num_iterations == 0) {
+    return;
+  }
+  const size_t num_threads = std::min(num_threads_, height_);
+  // Одному потоку согласовываться не с кем, он считает прямо в runner_.
+  if (num_threads == 1) {
+    for (size_t k = 0; k < num_iterations && !stop_; ++k) {
+      StepRows(0, height_, workspaces_[0]);
+      field_.swap(new_field_);
+      ++generation_;
+      workspaces_[0].census_.generation_ = generation_;
+      census_.Add(workspaces_[0].census_);
+    }
+    return;
+  }
+  barrier_.ResizeBarrier(num_threads);
+  stepping_ = true;
+  permission_ = true;
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < num_threads; ++t) {
+    workers.emplace_back(&GenerationsEngine::Worker, this,
+                         height_ * t / num_threads,
+                         height_ * (t + 1) / num_threads,
+                         std::ref(workspaces_[t]));
+  }
+
+  for (size_t k = 0; stepping_; ++k) {
+    std::unique_lock<std::mutex> lock(sync_mutex_);
+    while (permission_) {
+      all_threads_stopped_.wait(lock);
+    }
+    // Все потоки на барьере.
+    field_.swap(new_field_);
+    ++generation_;
+    Census census;
+    for (size_t t = 0; t < num_threads; ++t) {
+      census.Merge(workspaces_[t].census_);
+    }
+    census.generation_ = generation_;
+    census_.Add(census);
+
+    stepping_ = k + 1 < num_iterations && !stop_;
+    permission_ = true;
+    all_threads_stopped_.notify_one();
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+void GenerationsEngine::Worker(const size_t begin, const size_t end,
+                               Workspace& workspace) {
+  do {
+    StepRows(begin, end, workspace);
+    barrier_.PassThrough();
+  } while (stepping_);
+}
+
+void GenerationsEngine::PrepareRow(const size_t i, const size_t slot,
+                                   Workspace& workspace) const {
+  uint64_t* alive = workspace.alive_[slot].data();
+  for (size_t word = 0; word < words_; ++word) {
+    alive[word] = Alive(field_, i, word);
+  }
+  // Соседи слева и справа по тору: сдвиги на бит с переносом из соседних
+  // слов, у крайних слов - с другого конца строки.
+  const size_t last = words_ - 1;
+  const size_t last_bit = (width_ - 1) % kWordBits;
+  uint64_t* sum0 = workspace.sum0_[slot].data();
+  uint64_t* sum1 = workspace.sum1_[slot].data();
+  for (size_t word = 0; word < words_; ++word) {
+    uint64_t left_carry = word == 0 ? alive[last] >> last_bit
+                                    : alive[word - 1] >> (kWordBits - 1);
+    uint64_t right_carry = word == last ? (alive[0] & 1) << last_bit
+                                        : alive[word + 1] << (kWordBits - 1);
+    uint64_t left = (alive[word] << 1) | (left_carry & 1);
+    uint64_t right = (alive[word] >> 1) | right_carry;
+    if (word == last) {
+      left &= last_word_mask_;
+      right &= last_word_mask_;
+    }
+    FullAdd(left, alive[word], right, sum0[word], sum1[word]);
+  }
+}
+
+void GenerationsEngine::StepRows(const size_t begin, const size_t end,
+                                 Workspace& workspace) {
+  workspace.census_ = Census();
+  if (begin == end) {
+    return;
+  }
+  // Слоты окна сдвигаются по кругу: строка i лежит в слоте i % 3.
+  PrepareRow((begin + height_ - 1) % height_, (begin + 2) % 3, workspace);
+  PrepareRow(begin, begin % 3, workspace);
+
+  const int states = rules_.states_;
+  for (size_t i = begin; i < end; ++i) {
+    PrepareRow((i + 1) % height_, (i + 1) % 3, workspace);
+    const uint64_t* alive = workspace.alive_[i % 3].data();
+    const uint64_t* mid0 = workspace.sum0_[i % 3].data();
+    const uint64_t* mid1 = workspace.sum1_[i % 3].data();
+    const uint64_t* up0 = workspace.sum0_[(i + 2) % 3].data();
+    const uint64_t* up1 = workspace.sum1_[(i + 2) % 3].data();
+    const uint64_t* down0 = workspace.sum0_[(i + 1) % 3].data();
+    const uint64_t* down1 = workspace.sum1_[(i + 1) % 3].data();
+
+    long long first = -1;
+    long long last = -1;
+    for (size_t word = 0; word < words_; ++word) {
+      // Соседи по строке: сумма с клеткой без самой клетки.
+      uint64_t a = alive[word];
+      uint64_t side0 = mid0[word] ^ a;
+      uint64_t side1 = mid1[word] & (mid0[word] | ~a);
+
+      // Соседи: сверху (0..3) + снизу (0..3) + слева и справа (0..2), по
+      // битам n0..n3.
+      uint64_t n0, carry0, s, c;
+      FullAdd(up0[word], down0[word], side0, n0, carry0);
+      FullAdd(up1[word], down1[word], side1, s, c);
+      uint64_t n1 = s ^ carry0;
+      uint64_t carry1 = s & carry0;
+      uint64_t n2 = c ^ carry1;
+      uint64_t n3 = c & carry1;
+
+      uint64_t born = 0;
+      uint64_t stay = 0;
+      for (int n : counts_) {
+        uint64_t equal = (n & 1 ? n0 : ~n0) & (n & 2 ? n1 : ~n1) &
+                         (n & 4 ? n2 : ~n2) & (n & 8 ? n3 : ~n3);
+        born |= rules_.next_[0][n] ? equal : 0;
+        stay |= rules_.next_[1][n] ? equal : 0;
+      }
+
+      uint64_t any = 0;
+      for (size_t plane = 0; plane < planes_; ++plane) {
+        any |= Plane(field_, i, plane)[word];
+      }
+      uint64_t dead = ~any;
+      uint64_t dying = any & ~a;
+      uint64_t births = dead & born;
+      uint64_t deaths = a & ~stay;
+      if (word == words_ - 1) {
+        // За концом строки клетки должны оставаться мертвыми.
+        births &= last_word_mask_;
+      }
+
+      // Угасающие и только что умершие клетки переходят в следующее
+      // состояние, из последнего - в мертвое. Если число состояний - степень
+      // двойки, переполнение само дает 0.
+      uint64_t increment = deaths | dying;
+      uint64_t carry = increment;
+      uint64_t wrap = increment;
+      for (size_t plane = 0; plane < planes_; ++plane) {
+        uint64_t bit = Plane(field_, i, plane)[word];
+        uint64_t next = bit ^ carry;
+        carry &= bit;
+        Plane(new_field_, i, plane)[word] = next;
+        wrap &= (states >> plane) & 1 ? next : ~next;
+      }
+      for (size_t plane = 0; plane < planes_; ++plane) {
+        uint64_t& next = Plane(new_field_, i, plane)[word];
+        next &= ~wrap;
+        if (plane == 0) {
+          next |= births;
+        }
+      }
+
+      uint64_t new_alive = (a & stay) | births;
+      workspace.census_.births_ += __builtin_popcountll(births);
+      workspace.census_.deaths_ += __builtin_popcountll(deaths);
+      if (new_alive) {
+        workspace.census_.population_ += __builtin_popcountll(new_alive);
+        long long base = static_cast<long long>(word * kWordBits);
+        first = first < 0 ? base + __builtin_ctzll(new_alive) : first;
+        last = base + 63 - __builtin_clzll(new_alive);
+      }
+    }
+    if (first >= 0) {
+      workspace.census_.AddRow(i, first, last);
+    }
+  }
+}
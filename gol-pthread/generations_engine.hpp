@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "census.hpp"
+#include "cyclic_vector.hpp"
+#include "engine.hpp"
+#include "multithreading_utils.hpp"
+#include "rules.hpp"
+
+// Расчет правил Generations (b2/s/c3 и т. п.), у которых клетка после
+// смерти несколько итераций угасает. Состояние клетки хранится битовыми
+// плоскостями: для C состояний ceil(log2 C) плоскостей по биту на клетку,
+// у правил на два состояния - одна, как в упакованном файле поля. Итерация
+// считается побитовыми операциями над словами плоскостей: соседи
+// суммируются как в SoupEngine, состояние угасающих клеток увеличивается
+// сложением с переносом по плоскостям.
+// Строки делятся между потоками, которые создаются один раз на Run и
+// ждут друг друга между итерациями на CyclicBarrier.
+class GenerationsEngine : public Engine {
+ public:
+  GenerationsEngine(const size_t num_threads, const std::string& rules);
+
+  ~GenerationsEngine() override;
+
+  // Поле как у GameOfLife::Start(h_size, v_size): клетки живы с
+  // вероятностью 0.5, зерно 1337.
+  bool Start(const size_t h_size, const size_t v_size) override;
+
+  // Загрузка поля из .csv файла (цифра - состояние клетки), паттерна RLE
+  // или двоичного файла поля по байту на клетку. Правила из файла заменяют
+  // заданные, правила Larger than Life в файле - ошибка. Паттерн RLE с
+  // состояниями вне правил не загружается, в .csv и двоичном файле такие
+  // клетки считаются мертвыми.
+  bool Start(const std::string& filename, const size_t h_size,
+             const size_t v_size) override;
+
+  bool Run(const size_t num_iterations) override;
+
+  bool Wait() override;
+
+  // Сохранение по байту на клетку: в бите на клетку угасающие клетки
+  // не помещаются.
+  bool Save(const std::string& filename) override;
+
+  bool RecordCensus(const std::string& filename) override;
+
+  void Quit() override;
+
+ private:
+  // Буферы потока: три соседние строки по скользящему окну, для каждой -
+  // живые клетки и сумма клетки с соседями слева и справа (младший и
+  // старший биты).
+  struct Workspace {
+    std::vector<uint64_t> alive_[3];
+    std::vector<uint64_t> sum0_[3];
+    std::vector<uint64_t> sum1_[3];
+    Census census_;
+  };
+
+  // Правила и числа соседей, которые в них встречаются. Larger than Life не
+  // поддерживаются.
+  bool SetRules(const Rules& rules);
+
+  // Раскладка поля из байта на клетку по плоскостям.
+  bool Load(const CyclicVector<CyclicVector<char>>& field);
+
+  // Проведение поля через num_iterations итераций: запуск потоков и обмен
+  // полей и сводки, пока потоки стоят на барьере.
+  void RunIterations(const size_t num_iterations);
+
+  // Поток строк [begin, end): итерация и барьер, пока stepping_.
+  void Worker(const size_t begin, const size_t end, Workspace& workspace);
+
+  // Одна итерация строк [begin, end) из field_ в new_field_.
+  void StepRows(const size_t begin, const size_t end, Workspace& workspace);
+
+  // Живые клетки строки i и их суммы с соседями по строке в слот slot.
+  void PrepareRow(const size_t i, const size_t slot,
+                  Workspace& workspace) const;
+
+  // Начало плоскости plane строки i.
+  uint64_t* Plane(std::vector<uint64_t>& field, const size_t i,
+                  const size_t plane) {
+    return field.data() + (i * planes_ + plane) * words_;
+  }
+  const uint64_t* Plane(const std::vector<uint64_t>& field, const size_t i,
+                        const size_t plane) const {
+    return field.data() + (i * planes_ + plane) * words_;
+  }
+
+  // Живые клетки слова: состояние 1.
+  uint64_t Alive(const std::vector<uint64_t>& field, const size_t i,
+                 const size_t word) const;
+
+  Rules rules_;
+  std::vector<int> counts_;  // Числа соседей, при которых клетка жива.
+  size_t num_threads_;
+
+  size_t height_;
+  size_t width_;
+  size_t words_;   // Слов на строку плоскости.
+  size_t planes_;  // Плоскостей состояния.
+  uint64_t last_word_mask_;  // Клетки последнего слова строки.
+
+  std::vector<uint64_t> field_;
+  std::vector<uint64_t> new_field_;
+  std::vector<Workspace> workspaces_;
+  size_t generation_;
+
+  CensusLog census_;
+  std::thread runner_;
+  std::atomic<bool> stop_;
+
+  // Согласование потоков с runner_, как у GameOfLife: последний дошедший до
+  // барьера поток сбрасывает permission_ и ждет, пока runner_ обменяет поля
+  // и снова его выставит. stepping_ меняется только при стоящих потоках.
+  std::mutex sync_mutex_;
+  std::condition_variable all_threads_stopped_;
+  bool permission_;
+  bool stepping_;
+  CyclicBarrier barrier_;
+};
@@ -0,0 +1,223 @@
+#include <algorithm>
+
+#include "census.hpp"
+#include "history.hpp"
+#include "kernel.hpp"
+#include "zero_runs.hpp"
+
+History::History(const size_t memory_limit, const size_t keyframe_period,
+                 const size_t height, const size_t width)
+    : memory_limit_(memory_limit),
+      keyframe_period_(std::max<size_t>(keyframe_period, 1)),
+      height_(height),
+      width_(width),
+      row_size_((width + 7) / 8),
+      memory_used_(0) {
+}
+
+void History::Reset(const size_t generation, const Field& field) {
+  segments_.clear();
+  memory_used_ = 0;
+  Pack(field, packed_);
+  delta_.assign(packed_.size(), 0);
+  AddKeyframe(generation);
+}
+
+void History::PackRow(const size_t i, const CyclicVector<char>& line) {
+  unsigned char* packed = packed_.data() + i * row_size_;
+  unsigned char* delta = delta_.data() + i * row_size_;
+  for (size_t byte = 0; byte < row_size_; ++byte) {
+    unsigned char bits = PackByte(line.data(), byte);
+    delta[byte] = bits ^ packed[byte];
+    packed[byte] = bits;
+  }
+}
+
+void History::RepackRow(const size_t i, const CyclicVector<char>& line) {
+  unsigned char* packed = packed_.data() + i * row_size_;
+  unsigned char* delta = delta_.data() + i * row_size_;
+  // Разность остается от той же предыдущей итерации.
+  for (size_t byte = 0; byte < row_size_; ++byte) {
+    unsigned char bits = PackByte(line.data(), byte);
+    delta[byte] ^= bits ^ packed[byte];
+    packed[byte] = bits;
+  }
+}
+
+void History::Commit() {
+  Segment& last = segments_.back();
+  size_t generation = last.last_ + 1;
+  if ((generation - last.generation_) % keyframe_period_ == 0) {
+    AddKeyframe(generation);
+  } else {
+    last.deltas_.emplace_back();
+    EncodeZeroRuns(delta_, last.deltas_.back());
+    last.deltas_.back().shrink_to_fit();
+    memory_used_ += last.deltas_.back().capacity();
+    last.last_ = generation;
+  }
+  Shrink();
+}
+
+void History::Replace(const Field& field) {
+  Pack(field, packed_);
+  Segment& last = segments_.back();
+  size_t generation = last.last_;
+  if (last.generation_ == generation) {
+    memory_used_ -= SegmentMemory(last);
+    segments_.pop_back();
+  } else {
+    // Разность к замененной итерации больше не нужна, с нее начинается
+    // новый отрезок.
+    if (!last.deltas_dropped_) {
+      memory_used_ -= last.deltas_.back().capacity();
+      last.deltas_.pop_back();
+    }
+    --last.last_;
+  }
+  AddKeyframe(generation);
+  Shrink();
+}
+
+size_t History::First() const {
+  return segments_.front().generation_;
+}
+
+size_t History::Last() const {
+  return segments_.back().last_;
+}
+
+bool History::Restore(const size_t generation, const Rules& rules,
+                      Field& field) const {
+  if (segments_.empty() || generation < First() || generation > Last()) {
+    return false;
+  }
+  // Отрезки упорядочены по итерациям, ищется последний с ключевым кадром
+  // не позже generation.
+  auto segment = std::upper_bound(
+      segments_.begin(), segments_.end(), generation,
+      [](const size_t generation, const Segment& segment) {
+        return generation < segment.generation_;
+      });
+  --segment;
+
+  std::vector<unsigned char> packed(height_ * row_size_, 0);
+  ApplyZeroRuns(segment->key_, packed);
+  size_t steps = generation - segment->generation_;
+  if (!segment->deltas_dropped_) {
+    for (size_t k = 0; k < steps; ++k) {
+      ApplyZeroRuns(segment->deltas_[k], packed);
+    }
+    Unpack(packed, field);
+    return true;
+  }
+
+  Unpack(packed, field);
+  Field new_field = field;
+  Census census;
+  for (size_t k = 0; k < steps; ++k) {
+    CalculateRows(field, new_field, rules, 0, height_, 0, census,
+                  [](const long long, const bool) {});
+    field.swap(new_field);
+  }
+  return true;
+}
+
+void History::Truncate(const size_t generation, const Field& field) {
+  while (segments_.size() > 1 && segments_.back().generation_ > generation) {
+    memory_used_ -= SegmentMemory(segments_.back());
+    segments_.pop_back();
+  }
+  Segment& last = segments_.back();
+  if (last.generation_ > generation) {
+    Reset(generation, field);
+    return;
+  }
+  Pack(field, packed_);
+  if (!last.deltas_dropped_) {
+    size_t keep = generation - last.generation_;
+    for (size_t k = keep; k < last.deltas_.size(); ++k) {
+      memory_used_ -= last.deltas_[k].capacity();
+    }
+    last.deltas_.resize(keep);
+    last.last_ = generation;
+  } else if (generation == last.generation_) {
+    last.last_ = generation;
+    last.deltas_dropped_ = false;
+  } else {
+    // Отрезок без разностей не может продолжаться разностями, итерация
+    // generation начинает новый.
+    last.last_ = generation - 1;
+    AddKeyframe(generation);
+  }
+}
+
+unsigned char History::PackByte(const char* cells, const size_t byte) const {
+  unsigned char bits = 0;
+  size_t end = std::min(width_, byte * 8 + 8);
+  for (size_t j = byte * 8; j < end; ++j) {
+    bits |= static_cast<unsigned char>((cells[j] & 1) << (j % 8));
+  }
+  return bits;
+}
+
+void History::Pack(const Field& field,
+                   std::vector<unsigned char>& packed) const {
+  packed.resize(height_ * row_size_);
+  for (size_t i = 0; i < height_; ++i) {
+    for (size_t byte = 0; byte < row_size_; ++byte) {
+      packed[i * row_size_ + byte] = PackByte(field[i].data(), byte);
+    }
+  }
+}
+
+void History::Unpack(const std::vector<unsigned char>& packed,
+                     Field& field) const {
+  field.resize(height_);
+  for (size_t i = 0; i < height_; ++i) {
+    const unsigned char* row = packed.data() + i * row_size_;
+    field[i].resize(width_);
+    for (size_t j = 0; j < width_; ++j) {
+      field[i][j] = (row[j / 8] >> (j % 8)) & 1;
+    }
+  }
+}
+
+void History::AddKeyframe(const size_t generation) {
+  Segment segment;
+  segment.generation_ = generation;
+  segment.last_ = generation;
+  segment.deltas_dropped_ = false;
+  EncodeZeroRuns(packed_, segment.key_);
+  segment.key_.shrink_to_fit();
+  memory_used_ += SegmentMemory(segment);
+  segments_.push_back(std::move(segment));
+}
+
+size_t History::SegmentMemory(const Segment& segment) {
+  size_t memory = segment.key_.capacity();
+  for (const auto& delta : segment.deltas_) {
+    memory += delta.capacity();
+  }
+  return memory;
+}
+
+void History::Shrink() {
+  // Последний отрезок остается всегда: к нему дописываются итерации.
+  for (size_t i = 0; i + 1 < segments_.size() && memory_used_ > memory_limit_;
+       ++i) {
+    Segment& segment = segments_[i];
+    if (segment.deltas_dropped_ || segment.deltas_.empty()) {
+      continue;
+    }
+    memory_used_ -= SegmentMemory(segment);
+    segment.deltas_.clear();
+    segment.deltas_.shrink_to_fit();
+    segment.deltas_dropped_ = true;
+    memory_used_ += SegmentMemory(segment);
+  }
+  while (segments_.size() > 1 && memory_used_ > memory_limit_) {
+    memory_used_ -= SegmentMemory(segments_.front());
+    segments_.pop_front();
+  }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+
+#include <deque>
+#include <vector>
+
+#include "cyclic_vector.hpp"
+#include "rules.hpp"
+
+// История поколений в памяти: ключевой кадр каждые keyframe_period итераций
+// и сжатые разности соседних итераций между ними. Кадры - поле по биту на
+// клетку, сжатое по сериям нулей. Когда история не помещается в
+// memory_limit байт, у старейших отрезков выбрасываются разности (их
+// итерации пересчитываются от ключевого кадра), затем сами отрезки.
+class History {
+ public:
+  using Field = CyclicVector<CyclicVector<char>>;
+
+ public:
+  History(const size_t memory_limit, const size_t keyframe_period,
+          const size_t height, const size_t width);
+
+  // Начало истории с поля итерации generation.
+  void Reset(const size_t generation, const Field& field);
+
+  // Упаковка строки i следующей итерации и ее разности с текущей. Потоки
+  // вызывают для своих строк одновременно.
+  void PackRow(const size_t i, const CyclicVector<char>& line);
+
+  // Замена упакованной PackRow строки i следующей итерации (после правок).
+  void RepackRow(const size_t i, const CyclicVector<char>& line);
+
+  // Добавление следующей итерации, все строки которой упакованы PackRow.
+  void Commit();
+
+  // Замена последней итерации истории полем field (после правок).
+  void Replace(const Field& field);
+
+  // Первая и последняя итерации в истории.
+  size_t First() const;
+  size_t Last() const;
+
+  size_t MemoryUsed() const {
+    return memory_used_;
+  }
+
+  // Восстановление поля итерации generation. Итерации отрезков без
+  // разностей пересчитываются по rules.
+  bool Restore(const size_t generation, const Rules& rules,
+               Field& field) const;
+
+  // Забывание итераций после generation, которая становится текущей.
+  void Truncate(const size_t generation, const Field& field);
+
+ private:
+  // Ключевой кадр и разности следующих за ним итераций.
+  struct Segment {
+    size_t generation_;  // Итерация ключевого кадра.
+    size_t last_;        // Последняя итерация отрезка.
+    std::vector<unsigned char> key_;
+    std::vector<std::vector<unsigned char>> deltas_;
+    bool deltas_dropped_;
+  };
+
+  // Байт byte упакованной строки cells.
+  unsigned char PackByte(const char* cells, const size_t byte) const;
+
+  void Pack(const Field& field, std::vector<unsigned char>& packed) const;
+  void Unpack(const std::vector<unsigned char>& packed, Field& field) const;
+
+  // Новый отрезок с ключевым кадром packed_ на итерации generation.
+  void AddKeyframe(const size_t generation);
+
+  static size_t SegmentMemory(const Segment& segment);
+
+  // Выбрасывание старого, пока история не поместится в лимит.
+  void Shrink();
+
+ private:
+  size_t memory_limit_;
+  size_t keyframe_period_;
+  size_t height_;
+  size_t width_;
+  size_t row_size_;  // Байт на строку кадра.
+
+  std::deque<Segment> segments_;
+  size_t memory_used_;
+
+  std::vector<unsigned char> packed_;  // Текущая итерация по биту на клетку.
+  std::vector<unsigned char> delta_;   // Ее разность со следующей.
+};
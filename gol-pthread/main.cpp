@@ -1,11 +1,16 @@
+#include <chrono>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include "batch.hpp"
 #include "multithreading_utils.hpp"
 #include "cyclic_vector.hpp"
+#include "field_io.hpp"
 #include "game_of_life.hpp"
+#include "generations_engine.hpp"
 
 bool StrIsInt(const std::string& str) {
   for (auto c : str) {
@@ -16,29 +21,132 @@ bool StrIsInt(const std::string& str) {
   return !str.empty();
 }
 
+// Лимит памяти очереди записи итераций по умолчанию.
+const size_t kRecordMemoryLimit = 256 << 20;
+// Итераций между ключевыми кадрами истории по умолчанию.
+const size_t kHistoryKeyframePeriod = 64;
+// Строк в полосе и итераций за проход команды stream по умолчанию.
+const size_t kStreamBandRows = 256;
+const size_t kStreamGenerationsPerPass = 1;
+
 void PrintHelp() {
   std::cout << "Conway\'s Game of Life.\n"
                "Arguments: <rules> <num_threads>\n"
+               "\tor batch mode arguments starting with -- (see --help)\n"
                "Rules:\n"
                "\tThe rules are set as a first argument of the program in "
                "format (regexp) b\\d+/s\\d+,\n\twhere digits after b are "
                "associated with numbers of alive cells around a cell\n\tneeded "
                "to bring the dead cell alive, and digits after s - to keep the "
                "cell alive.\n\tOriginal rules are b3/s23.\n"
+               "\tLarger than Life rules are set as r<r>,m<0|1>,s<a>..<b>,"
+               "b<d>..<e>:\n\ta cell looks at (2r + 1) x (2r + 1) cells "
+               "around it (itself included\n\tif m1), survives with a to b "
+               "of them alive and is born with d to e.\n\tOptional fields "
+               "c0 (two states, c1 and c2 mean the same) and nm\n\t(Moore "
+               "neighborhood) are the only values supported and are left "
+               "out\n\twhen the rules are saved. For example "
+               "r5,c0,m1,s34..58,b34..45,nm\n\t(Bosco) is saved as "
+               "r5,m1,s34..58,b34..45; r is at most 31.\n"
+               "\tGenerations rules add /c<n> with n states: a cell that "
+               "stops living\n\tfades through states 2..n-1 before it is "
+               "dead and does not count\n\tas a neighbor meanwhile, e.g. "
+               "b2/s/c3 (Brian's Brain). They run\n\tin batch mode only, "
+               "with the field saved a byte per cell.\n"
                "Commands:\n"
                "\tstart <n> <m> - create a field sized (n x m) with "
                "number of alive and dead cells\n"
                "\tstart <filename> - create a field from \'filename\' "
-               "file (should be .csv format)\n"
+               "file (.csv format, .rle\n\t\tpattern or binary field saved "
+               "with save)\n"
+               "\tstart <filename> <n> <m> - place an .rle pattern in the "
+               "middle of a field\n\t\tsized at least (n x m)\n"
+               "\tsave <filename> - save the stopped field with its rules "
+               "and iteration\n\t\tto a binary file\n"
+               "\tcheckpoint <filename> - write the field to 'filename' in "
+               "the background,\n\t\tcalculations continue\n"
+               "\tcheckpoint <filename> <k> - checkpoint every k-th "
+               "iteration\n"
+               "\tcheckpoint off - disable automatic checkpoints\n"
+               "\trestore <filename> - create a field from a checkpoint\n"
+               "\trecord <filename> <k> [<mb>] - write every k-th iteration "
+               "to 'filename'\n\t\tin the background, keeping at most <mb> "
+               "megabytes queued (256)\n"
+               "\trecord off - stop calculations and finish recording\n"
+               "\tstream <input> <output> <n> [<rows> [<k>]] - run n "
+               "iterations of a binary\n\t\tfield saved with save without "
+               "loading it into memory, passing\n\t\tthrough it in bands of "
+               "<rows> rows (256), k iterations per pass (1)\n"
+               "\tsoup <count> <n> <m> <k> [<filename>] - run count random "
+               "fields\n\t\tsized (n x m) for at most k iterations each, "
+               "64 fields per\n\t\tmachine word, and show how many died or "
+               "became periodic;\n\t\tfield i is the one created by start "
+               "with seed 1337 + i;\n\t\tper field results are written to "
+               "\'filename\' as .csv\n"
                "\tstatus - show current game status\n"
+               "\tstats [json] - show time spent by threads in each phase of "
+               "iterations\n"
+               "\tstats reset - reset phase times and performance counters "
+               "of the\n\t\tstopped field\n"
+               "\tperf on|off - sample CPU performance counters around "
+               "calculations\n"
+               "\tperf [json] - show IPC, cache misses and cell updates per "
+               "second\n\t\tby threads\n"
+               "\tcensus [<n>] - show population, births, deaths and bounding "
+               "box of\n\t\tthe last n iterations (10)\n"
+               "\tcensus record <filename> - write them for every next "
+               "iteration\n\t\tto a .csv file\n"
+               "\tcensus off - stop writing them\n"
+               "\thistory <mb> [<k>] - keep next iterations in memory, at most "
+               "mb megabytes,\n\t\twith a full frame every k iterations (64) "
+               "and changes in between\n"
+               "\thistory off - forget the history\n"
+               "\thistory - show iterations kept in the history\n"
+               "\trewind <g> - return the stopped field to iteration g from "
+               "the history\n"
+               "\tset <x> <y> - make the cell at column x, row y alive; "
+               "applied between\n\t\titerations without stopping them\n"
+               "\tclear <x> <y> - make the cell at column x, row y dead\n"
+               "\tpaste <filename> <x> <y> - put an .rle or .csv pattern "
+               "with its top left\n\t\tcorner at column x, row y\n"
+               "\tview <x> <y> <w> <h> [<zoom>] - show (w x h) cells of the "
+               "stopped field\n\t\tstarting at column x, row y; with zoom "
+               "each (zoom x zoom) block\n\t\tis shown by its density\n"
+               "\tquery <x> <y> <w> <h> <g> - show (w x h) cells of the field "
+               "at column x,\n\t\trow y as they will be g iterations "
+               "later, computing only the cells\n\t\tthey depend on\n"
                "\trun <n> - run n iterations of game\n"
+               "\twait - wait for the running iterations to finish and show "
+               "the time\n\t\tsince the last run\n"
                "\tstop - stop calculations if any\n"
+               "\tcancel - stop calculations without waiting for them\n"
                "\tquit - quit program\n"
                "\thelp - show help\n"
                "All commands should be written in lower case!\n";
 }
 
 int main(int argc, char** argv) {
+  if (IsBatchMode(argc, argv)) {
+    BatchOptions options;
+    if (!ParseBatchOptions(argc, argv, options, std::cerr)) {
+      PrintBatchHelp(std::cerr);
+      return 1;
+    }
+    // Правила Generations считает отдельный движок на битовых плоскостях.
+    // Двоичные поля и паттерны RLE приносят свои правила.
+    std::string rules = options.rules;
+    if (!options.input.empty()) {
+      std::string file_rules = LoadBoardRules(options.input);
+      rules = file_rules.empty() ? rules : file_rules;
+    }
+    if (ParseRules(rules).states_ > 2) {
+      GenerationsEngine engine(options.threads, rules);
+      return RunBatch(engine, options, std::cout, std::cerr);
+    }
+    GameOfLife gol(options.threads, rules);
+    return RunBatch(gol, options, std::cout, std::cerr);
+  }
+
   std::string rules = "b3/s23";
   size_t num_threads = 4;
   if (argc >= 2) {
@@ -55,6 +163,12 @@ int main(int argc, char** argv) {
       rules = argv[2];
     }
   }
+  if (ParseRules(rules).states_ > 2) {
+    std::cout << "Generations rules are supported in batch mode only, e.g.\n"
+                 "\t--rules " << rules << " --size 512x512 --generations "
+                 "100 --output final.bin\n";
+    return 1;
+  }
   GameOfLife gol(num_threads, rules);
 
   for (size_t i = 0; i < 22; ++i) {
@@ -68,6 +182,8 @@ int main(int argc, char** argv) {
   std::cout << "\n";
 
   bool quit = false;
+  // Время последней команды run, от него отсчитывает wait.
+  auto run_begin = std::chrono::steady_clock::now();
   while (!quit) {
     std::string line;
     std::getline(std::cin, line);
@@ -91,7 +207,11 @@ int main(int argc, char** argv) {
 
       bool correct;
       if (!StrIsInt(args[1])) {
-        correct = gol.Start(args[1]);
+        if (args.size() >= 4 && StrIsInt(args[2]) && StrIsInt(args[3])) {
+          correct = gol.Start(args[1], std::stol(args[2]), std::stol(args[3]));
+        } else {
+          correct = gol.Start(args[1]);
+        }
       } else {
         if (args.size() < 3) {
           std::cout << args[0] << ": not enough arguments\n";
@@ -103,7 +223,148 @@ int main(int argc, char** argv) {
       if (correct) {
         std::cout << "Successfully created field.\n";
       } else {
-        std::cout << "Field already created. Quit program to make a new one.\n";
+        std::cout << "Field already created or file could not be read. "
+                     "Quit program to make a new one.\n";
+      }
+
+    } else if (args[0] == "save") {
+      if (args.size() < 2) {
+        std::cout << args[0] << ": not enough arguments\n";
+        continue;
+      }
+      if (gol.Save(args[1])) {
+        std::cout << "Saved field to " << args[1] << ".\n";
+      } else {
+        std::cout << args[0] << ": no field, still running or file could "
+                     "not be written.\n";
+      }
+
+    } else if (args[0] == "checkpoint") {
+      if (args.size() < 2 || args[1].empty()) {
+        std::cout << args[0] << ": not enough arguments\n";
+        continue;
+      }
+      if (args[1] == "off") {
+        gol.SetAutoCheckpoint("", 0);
+        std::cout << "Automatic checkpoints disabled.\n";
+      } else if (args.size() >= 3 && !args[2].empty()) {
+        if (!StrIsInt(args[2])) {
+          std::cout << args[0] << ": invalid argument.\n";
+          continue;
+        }
+        gol.SetAutoCheckpoint(args[1], std::stol(args[2]));
+        std::cout << "Checkpoint to " << args[1] << " every " << args[2]
+                  << " iterations.\n";
+      } else if (gol.Checkpoint(args[1])) {
+        std::cout << "Writing checkpoint to " << args[1] << ".\n";
+      } else {
+        std::cout << args[0] << ": no field has been created yet.\n";
+      }
+
+    } else if (args[0] == "restore") {
+      if (args.size() < 2) {
+        std::cout << args[0] << ": not enough arguments\n";
+        continue;
+      }
+      if (gol.Restore(args[1])) {
+        std::cout << "Successfully restored field.\n";
+      } else {
+        std::cout << args[0] << ": field already created or " << args[1]
+                  << " is not a checkpoint.\n";
+      }
+
+    } else if (args[0] == "record") {
+      if (args.size() >= 2 && args[1] == "off") {
+        if (gol.StopRecording()) {
+          std::cout << "Recording finished.\n";
+        } else {
+          std::cout << args[0] << ": not recording or file could not be "
+                       "written.\n";
+        }
+        continue;
+      }
+      if (args.size() < 3) {
+        std::cout << args[0] << ": not enough arguments\n";
+        continue;
+      }
+      if (!StrIsInt(args[2]) || std::stol(args[2]) == 0 ||
+          (args.size() >= 4 && !args[3].empty() && !StrIsInt(args[3]))) {
+        std::cout << args[0] << ": invalid argument.\n";
+        continue;
+      }
+      size_t memory_limit = kRecordMemoryLimit;
+      if (args.size() >= 4 && !args[3].empty()) {
+        memory_limit = std::stol(args[3]) << 20;
+      }
+      if (gol.Record(args[1], std::stol(args[2]), memory_limit)) {
+        std::cout << "Recording every " << args[2] << " iteration to "
+                  << args[1] << ".\n";
+      } else {
+        std::cout << args[0] << ": no field, still running, already "
+                     "recording or file could not be opened.\n";
+      }
+
+    } else if (args[0] == "stream") {
+      if (args.size() < 4) {
+        std::cout << args[0] << ": not enough arguments\n";
+        continue;
+      }
+      if (!StrIsInt(args[3]) ||
+          (args.size() >= 5 && !args[4].empty() && !StrIsInt(args[4])) ||
+          (args.size() >= 6 && !args[5].empty() && !StrIsInt(args[5]))) {
+        std::cout << args[0] << ": invalid argument.\n";
+        continue;
+      }
+      size_t band_rows = kStreamBandRows;
+      size_t generations_per_pass = kStreamGenerationsPerPass;
+      if (args.size() >= 5 && !args[4].empty()) {
+        band_rows = std::stol(args[4]);
+      }
+      if (args.size() >= 6 && !args[5].empty()) {
+        generations_per_pass = std::stol(args[5]);
+      }
+      auto begin = std::chrono::steady_clock::now();
+      if (gol.Stream(args[1], args[2], std::stol(args[3]), band_rows,
+                     generations_per_pass)) {
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - begin;
+        std::cout << "Streamed " << args[3] << " iterations to " << args[2]
+                  << " in " << elapsed.count() << " s.\n";
+      } else {
+        std::cout << args[0] << ": " << args[1] << " is not a packed binary "
+                     "field, " << args[2] << " could not be written or the "
+                     "rules\n\thave radius above 1.\n";
+      }
+
+    } else if (args[0] == "soup") {
+      if (args.size() < 5) {
+        std::cout << args[0] << ": not enough arguments\n";
+        continue;
+      }
+      if (!StrIsInt(args[1]) || !StrIsInt(args[2]) || !StrIsInt(args[3]) ||
+          !StrIsInt(args[4])) {
+        std::cout << args[0] << ": invalid argument.\n";
+        continue;
+      }
+      auto begin = std::chrono::steady_clock::now();
+      auto results = gol.Soup(std::stol(args[1]), std::stol(args[2]),
+                              std::stol(args[3]), std::stol(args[4]), 0.5,
+                              1337);
+      if (results.empty() && std::stol(args[1]) > 0) {
+        std::cout << args[0] << ": only rules with radius 1 are supported.\n";
+        continue;
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - begin;
+      std::cout << "Finished " << results.size() << " fields in "
+                << elapsed.count() << " s.\n";
+      SoupEngine::PrintSummary(results, std::cout);
+      if (args.size() >= 6) {
+        std::ofstream out(args[5]);
+        SoupEngine::PrintCsv(results, out);
+        if (!out) {
+          std::cout << args[0] << ": could not write " << args[5] << ".\n";
+        }
       }
 
     } else if (args[0] == "status") {
@@ -111,6 +372,177 @@ int main(int argc, char** argv) {
         gol.PrintField();
       }
 
+    } else if (args[0] == "stats") {
+      if (args.size() >= 2 && args[1] == "reset") {
+        if (gol.ResetStats()) {
+          std::cout << "Statistics reset.\n";
+        } else {
+          std::cout << args[0] << ": still running or no field has been "
+                       "created yet.\n";
+        }
+        continue;
+      }
+      gol.PrintStats(args.size() >= 2 && args[1] == "json");
+
+    } else if (args[0] == "perf") {
+      if (args.size() >= 2 && (args[1] == "on" || args[1] == "off")) {
+        gol.SetPerfCounters(args[1] == "on");
+        std::cout << "Performance counters " << args[1] << ".\n";
+        continue;
+      }
+      gol.PrintPerf(args.size() >= 2 && args[1] == "json");
+
+    } else if (args[0] == "census") {
+      if (args.size() >= 2 && (args[1] == "record" || args[1] == "off")) {
+        if (args[1] == "record" && (args.size() < 3 || args[2].empty())) {
+          std::cout << args[0] << ": not enough arguments\n";
+        } else if (gol.RecordCensus(args[1] == "off" ? "" : args[2])) {
+          std::cout << (args[1] == "off" ? "Census recording stopped.\n"
+                                         : "Recording census.\n");
+        } else {
+          std::cout << args[0] << ": could not open the file.\n";
+        }
+        continue;
+      }
+      if (args.size() >= 2 && !args[1].empty() && !StrIsInt(args[1])) {
+        std::cout << args[0] << ": invalid argument.\n";
+        continue;
+      }
+      gol.PrintCensus(args.size() >= 2 && !args[1].empty()
+                          ? std::stol(args[1])
+                          : 10);
+
+    } else if (args[0] == "set" || args[0] == "clear" ||
+               args[0] == "paste") {
+      size_t first = args[0] == "paste" ? 2 : 1;
+      if (args.size() < first + 2) {
+        std::cout << args[0] << ": not enough arguments\n";
+        continue;
+      }
+      if (!StrIsInt(args[first]) || !StrIsInt(args[first + 1])) {
+        std::cout << args[0] << ": invalid argument.\n";
+        continue;
+      }
+      long long x = std::stol(args[first]);
+      long long y = std::stol(args[first + 1]);
+      std::vector<CellEdit> edits;
+      if (args[0] == "paste") {
+        if (!LoadPatternEdits(args[1], x, y, edits)) {
+          std::cout << args[0] << ": could not load " << args[1] << ".\n";
+          continue;
+        }
+      } else {
+        edits.push_back({y, x, static_cast<char>(args[0] == "set")});
+      }
+      size_t count = edits.size();
+      if (gol.Edit(std::move(edits))) {
+        std::cout << "Edited " << count << " cells.\n";
+      } else {
+        std::cout << args[0] << ": no field has been created yet.\n";
+      }
+
+    } else if (args[0] == "history") {
+      if (args.size() >= 2 && args[1] == "off") {
+        if (gol.SetHistory(0, 0)) {
+          std::cout << "History is off.\n";
+        } else {
+          gol.PrintStatus();
+        }
+        continue;
+      }
+      if (args.size() < 2 || args[1].empty()) {
+        if (!gol.PrintHistory()) {
+          gol.PrintStatus();
+        }
+        continue;
+      }
+      if (!StrIsInt(args[1]) || std::stol(args[1]) == 0 ||
+          (args.size() >= 3 && !args[2].empty() && !StrIsInt(args[2]))) {
+        std::cout << args[0] << ": invalid argument.\n";
+        continue;
+      }
+      size_t keyframe_period = args.size() >= 3 && !args[2].empty()
+                                   ? std::stol(args[2])
+                                   : kHistoryKeyframePeriod;
+      if (gol.SetHistory(std::stol(args[1]) << 20, keyframe_period)) {
+        gol.PrintHistory();
+      } else {
+        gol.PrintStatus();
+      }
+
+    } else if (args[0] == "rewind") {
+      if (args.size() < 2) {
+        std::cout << args[0] << ": not enough arguments\n";
+        continue;
+      }
+      if (!StrIsInt(args[1])) {
+        std::cout << args[0] << ": invalid argument.\n";
+        continue;
+      }
+      auto begin = std::chrono::steady_clock::now();
+      if (gol.Rewind(std::stol(args[1]))) {
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - begin;
+        std::cout << "Rewound in " << elapsed.count() << " s.\n";
+        gol.PrintStatus();
+      } else {
+        std::cout << args[0] << ": could not rewind to " << args[1] << ".\n";
+        if (!gol.PrintHistory()) {
+          gol.PrintStatus();
+        }
+      }
+
+    } else if (args[0] == "view") {
+      if (args.size() < 5) {
+        std::cout << args[0] << ": not enough arguments\n";
+        continue;
+      }
+      bool valid = true;
+      for (size_t i = 1; i < args.size() && i < 6; ++i) {
+        valid = valid && ((i == 5 && args[i].empty()) || StrIsInt(args[i]));
+      }
+      if (!valid) {
+        std::cout << args[0] << ": invalid argument.\n";
+        continue;
+      }
+      size_t zoom = args.size() >= 6 && !args[5].empty() ? std::stol(args[5])
+                                                         : 1;
+      if (!gol.View(std::stol(args[1]), std::stol(args[2]),
+                    std::stol(args[3]), std::stol(args[4]), zoom)) {
+        gol.PrintStatus();
+      }
+
+    } else if (args[0] == "query") {
+      if (args.size() < 6) {
+        std::cout << args[0] << ": not enough arguments\n";
+        continue;
+      }
+      bool valid = true;
+      for (size_t i = 1; i < 6; ++i) {
+        valid = valid && StrIsInt(args[i]);
+      }
+      if (!valid) {
+        std::cout << args[0] << ": invalid argument.\n";
+        continue;
+      }
+      CyclicVector<CyclicVector<char>> region;
+      size_t generation = 0;
+      auto begin = std::chrono::steady_clock::now();
+      if (!gol.QueryRegion(std::stol(args[1]), std::stol(args[2]),
+                           std::stol(args[3]), std::stol(args[4]),
+                           std::stol(args[5]), region, generation)) {
+        std::cout << args[0] << ": no field has been created yet.\n";
+        continue;
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - begin;
+      TilePopulation population;
+      CountTiles(region, population);
+      std::cout << "Region at " << generation << " iteration, computed in "
+                << elapsed.count() << " s:\n"
+                << RenderView(region, population, 0, 0, region[0].size(),
+                              region.size(), 1);
+
     } else if (args[0] == "run") {
       if (args.size() < 2) {
         std::cout << args[0] << ": not enough arguments\n";
@@ -124,9 +556,20 @@ int main(int argc, char** argv) {
         std::cout << args[0]
                   << ": already running or no field has been created yet.\n";
       } else {
+        run_begin = std::chrono::steady_clock::now();
         std::cout << "Started running " << std::stol(args[1]) << " iterations.\n";
       }
 
+    } else if (args[0] == "wait") {
+      if (!gol.Wait()) {
+        std::cout << args[0] << ": no field has been created yet.\n";
+        continue;
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - run_begin;
+      std::cout << "Finished in " << elapsed.count() << " s.\n";
+      gol.PrintStatus();
+
     } else if (args[0] == "stop") {
       if (gol.Stop()) {
         gol.PrintStatus();
@@ -135,6 +578,12 @@ int main(int argc, char** argv) {
                   << ": no field has been created yet.\n";
       }
 
+    } else if (args[0] == "cancel") {
+      if (!gol.Cancel()) {
+        std::cout << args[0]
+                  << ": no field has been created yet.\n";
+      }
+
     } else if (args[0] == "quit") {
       gol.Quit();
       if (gol.PrintStatus()) {
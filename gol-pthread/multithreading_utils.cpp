@@ -78,7 +78,7 @@ void ReaderWriterLock::WriterUnlock() {
 
 // CyclicBarrier
 
-void CyclicBarrier::PassThrough() {
+std::chrono::steady_clock::time_point CyclicBarrier::PassThrough() {
   std::unique_lock<std::mutex> lock(mutex_);
 
   --num_threads_;
@@ -88,6 +88,7 @@ void CyclicBarrier::PassThrough() {
   }
 
   if (current_barrier_state == barrier_state_) {
+    all_entered_ = std::chrono::steady_clock::now();
     barrier_state_ = !barrier_state_;
     num_threads_ = capacity_;
     {
@@ -100,6 +101,7 @@ void CyclicBarrier::PassThrough() {
     }
     all_threads_entered_.notify_all();
   }
+  return all_entered_;
 }
 
 bool CyclicBarrier::ResizeBarrier(const size_t new_capacity) {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 
@@ -52,7 +53,9 @@ class CyclicBarrier {
         permission_(permission) {
   }
 
-  void PassThrough();
+  // Возвращает момент, когда до барьера дошел последний поток. Остальное
+  // время в барьере поток ждет согласования с главным потоком.
+  std::chrono::steady_clock::time_point PassThrough();
 
   bool ResizeBarrier(const size_t new_capacity);
 
@@ -60,6 +63,7 @@ class CyclicBarrier {
   size_t num_threads_;
   size_t capacity_;
   bool barrier_state_;
+  std::chrono::steady_clock::time_point all_entered_;
 
   std::mutex mutex_;
   std::condition_variable all_threads_entered_;
@@ -0,0 +1,233 @@
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iomanip>
+
+#include "perf_counters.hpp"
+
+namespace {
+
+// Тип и номер события perf для каждого PerfCounters::Event.
+const uint32_t kEventTypes[PerfCounters::EventsCount] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+    PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE};
+const uint64_t kEventConfigs[PerfCounters::EventsCount] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_SW_TASK_CLOCK};
+
+const uint64_t kCacheLineSize = 64;
+
+int OpenEvent(const uint32_t type, const uint64_t config, const int group) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  // Группа включается целиком через лидера.
+  attr.disabled = group == -1 ? 1 : 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, group,
+                                  0));
+}
+
+void PrintValue(std::ostream& out, const double value, const int width) {
+  if (value < 0) {
+    out << std::setw(width) << "n/a";
+  } else {
+    out << std::setw(width) << value;
+  }
+}
+
+}  // namespace
+
+PerfCounters::PerfCounters() : leader_(-1), mask_(0) {
+  for (int event = 0; event < EventsCount; ++event) {
+    fds_[event] = OpenEvent(kEventTypes[event], kEventConfigs[event], leader_);
+    if (fds_[event] < 0) {
+      continue;
+    }
+    if (leader_ == -1) {
+      leader_ = fds_[event];
+    }
+    mask_ |= 1u << event;
+    order_.push_back(static_cast<Event>(event));
+  }
+  if (leader_ != -1) {
+    ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  for (auto fd : fds_) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+bool PerfCounters::Read(uint64_t values[EventsCount]) const {
+  std::memset(values, 0, EventsCount * sizeof(uint64_t));
+  if (leader_ == -1) {
+    return false;
+  }
+  // Формат PERF_FORMAT_GROUP: число событий, затем их значения.
+  uint64_t buffer[EventsCount + 1];
+  ssize_t size = read(leader_, buffer, sizeof(buffer));
+  if (size < static_cast<ssize_t>(sizeof(uint64_t)) ||
+      buffer[0] != order_.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < order_.size(); ++i) {
+    values[order_[i]] = buffer[i + 1];
+  }
+  return true;
+}
+
+PerfTotals::PerfTotals() {
+  Reset();
+}
+
+void PerfTotals::Add(const unsigned mask, const uint64_t* before,
+                     const uint64_t* after, const uint64_t nanoseconds,
+                     const uint64_t cells) {
+  mask_.store(Generations() == 0 ? mask
+                                 : mask_.load(std::memory_order_relaxed) & mask,
+              std::memory_order_relaxed);
+  for (int event = 0; event < PerfCounters::EventsCount; ++event) {
+    Bump(values_[event], after[event] - before[event]);
+  }
+  Bump(nanoseconds_, nanoseconds);
+  Bump(cells_, cells);
+  Bump(generations_, 1);
+}
+
+void PerfTotals::Merge(const PerfTotals& other) {
+  if (other.Generations() == 0) {
+    return;
+  }
+  unsigned mask = other.mask_.load(std::memory_order_relaxed);
+  mask_.store(Generations() == 0 ? mask
+                                 : mask_.load(std::memory_order_relaxed) & mask,
+              std::memory_order_relaxed);
+  for (int event = 0; event < PerfCounters::EventsCount; ++event) {
+    Bump(values_[event], other.values_[event].load(std::memory_order_relaxed));
+  }
+  Bump(nanoseconds_, other.nanoseconds_.load(std::memory_order_relaxed));
+  Bump(cells_, other.cells_.load(std::memory_order_relaxed));
+  Bump(generations_, other.Generations());
+}
+
+void PerfTotals::Reset() {
+  mask_.store(0, std::memory_order_relaxed);
+  for (auto& value : values_) {
+    value.store(0, std::memory_order_relaxed);
+  }
+  generations_.store(0, std::memory_order_relaxed);
+  nanoseconds_.store(0, std::memory_order_relaxed);
+  cells_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t PerfTotals::Generations() const {
+  return generations_.load(std::memory_order_relaxed);
+}
+
+double PerfTotals::CellUpdatesPerSecond() const {
+  uint64_t nanoseconds = nanoseconds_.load(std::memory_order_relaxed);
+  if (nanoseconds == 0) {
+    return -1;
+  }
+  return cells_.load(std::memory_order_relaxed) * 1e9 / nanoseconds;
+}
+
+double PerfTotals::InstructionsPerCycle() const {
+  uint64_t cycles = values_[PerfCounters::Cycles].load(
+      std::memory_order_relaxed);
+  if (!Has(PerfCounters::Cycles) || !Has(PerfCounters::Instructions) ||
+      cycles == 0) {
+    return -1;
+  }
+  return static_cast<double>(values_[PerfCounters::Instructions].load(
+             std::memory_order_relaxed)) / cycles;
+}
+
+double PerfTotals::CacheMissRate() const {
+  uint64_t references = values_[PerfCounters::CacheReferences].load(
+      std::memory_order_relaxed);
+  if (!Has(PerfCounters::CacheReferences) ||
+      !Has(PerfCounters::CacheMisses) || references == 0) {
+    return -1;
+  }
+  return static_cast<double>(values_[PerfCounters::CacheMisses].load(
+             std::memory_order_relaxed)) / references;
+}
+
+double PerfTotals::MemoryBytesPerSecond() const {
+  uint64_t nanoseconds = nanoseconds_.load(std::memory_order_relaxed);
+  if (!Has(PerfCounters::CacheMisses) || nanoseconds == 0) {
+    return -1;
+  }
+  return values_[PerfCounters::CacheMisses].load(std::memory_order_relaxed) *
+         kCacheLineSize * 1e9 / nanoseconds;
+}
+
+double PerfTotals::CpuUtilization() const {
+  uint64_t nanoseconds = nanoseconds_.load(std::memory_order_relaxed);
+  if (!Has(PerfCounters::TaskClock) || nanoseconds == 0) {
+    return -1;
+  }
+  return static_cast<double>(values_[PerfCounters::TaskClock].load(
+             std::memory_order_relaxed)) / nanoseconds;
+}
+
+void PerfTotals::PrintHeader(std::ostream& out) {
+  out << std::left << std::setw(12) << "thread" << std::right
+      << std::setw(8) << "iters" << std::setw(14) << "cells/s"
+      << std::setw(8) << "IPC" << std::setw(10) << "miss %"
+      << std::setw(12) << "mem MB/s" << std::setw(8) << "cpu %" << "\n";
+}
+
+void PerfTotals::PrintRow(std::ostream& out, const std::string& name) const {
+  auto flags = out.flags();
+  auto precision = out.precision();
+  double miss_rate = CacheMissRate();
+  double bandwidth = MemoryBytesPerSecond();
+  double utilization = CpuUtilization();
+  out << std::left << std::setw(12) << name << std::right << std::setw(8)
+      << Generations() << std::scientific << std::setprecision(3);
+  PrintValue(out, CellUpdatesPerSecond(), 14);
+  out << std::fixed << std::setprecision(2);
+  PrintValue(out, InstructionsPerCycle(), 8);
+  PrintValue(out, miss_rate < 0 ? -1 : 100 * miss_rate, 10);
+  out << std::setprecision(1);
+  PrintValue(out, bandwidth < 0 ? -1 : bandwidth / 1e6, 12);
+  PrintValue(out, utilization < 0 ? -1 : 100 * utilization, 8);
+  out << "\n";
+  out.flags(flags);
+  out.precision(precision);
+}
+
+void PerfTotals::PrintJson(std::ostream& out) const {
+  const char* names[PerfCounters::EventsCount] = {
+      "cycles", "instructions", "cache_references", "cache_misses",
+      "task_clock_ns"};
+  out << "{\"generations\": " << Generations()
+      << ", \"compute_ns\": " << nanoseconds_.load(std::memory_order_relaxed)
+      << ", \"cells\": " << cells_.load(std::memory_order_relaxed);
+  // Недоступные счетчики в JSON равны null.
+  for (int event = 0; event < PerfCounters::EventsCount; ++event) {
+    out << ", \"" << names[event] << "\": ";
+    if (Has(static_cast<PerfCounters::Event>(event))) {
+      out << values_[event].load(std::memory_order_relaxed);
+    } else {
+      out << "null";
+    }
+  }
+  out << "}";
+}
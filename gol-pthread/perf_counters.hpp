@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Счетчики производительности вызывающего потока через perf_event_open.
+// Счетчики, которые не удалось открыть (нет прав, контейнер, виртуальная
+// машина без PMU), просто отсутствуют: AvailableMask сообщает, какие есть.
+class PerfCounters {
+ public:
+  enum Event {
+    Cycles,
+    Instructions,
+    CacheReferences,
+    CacheMisses,
+    TaskClock,  // Время на процессоре в наносекундах, программный счетчик.
+    EventsCount
+  };
+
+ public:
+  // Открывает счетчики для вызывающего потока.
+  PerfCounters();
+
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  // Битовая маска открытых событий.
+  unsigned AvailableMask() const {
+    return mask_;
+  }
+
+  // Текущие значения всех счетчиков одним чтением группы. Отсутствующие
+  // счетчики равны нулю. Возвращает false, если не открыт ни один.
+  bool Read(uint64_t values[EventsCount]) const;
+
+ private:
+  int fds_[EventsCount];
+  int leader_;
+  unsigned mask_;
+  std::vector<Event> order_;  // События в порядке чтения группы.
+};
+
+// Суммы счетчиков по замеренным итерациям одного или нескольких потоков.
+// Как и TimeHistogram, пишется одним потоком и читается из любого.
+class PerfTotals {
+ public:
+  PerfTotals();
+
+  PerfTotals(const PerfTotals&) = delete;
+  PerfTotals& operator=(const PerfTotals&) = delete;
+
+  // Учет итерации: значения счетчиков до и после, время и число клеток.
+  void Add(const unsigned mask, const uint64_t* before, const uint64_t* after,
+           const uint64_t nanoseconds, const uint64_t cells);
+
+  void Merge(const PerfTotals& other);
+
+  void Reset();
+
+  uint64_t Generations() const;
+
+  // Строка таблицы: итерации, обновления клеток в секунду времени
+  // вычислений (у суммы - в среднем на поток), IPC, промахи
+  // кэша, оценка трафика памяти (промах - строка в 64 байта) и загрузка
+  // процессора. Недоступные величины выводятся как n/a.
+  void PrintRow(std::ostream& out, const std::string& name) const;
+
+  void PrintJson(std::ostream& out) const;
+
+  static void PrintHeader(std::ostream& out);
+
+  // Величины для отчетов. Отрицательное значение - величина недоступна.
+  double CellUpdatesPerSecond() const;
+  double InstructionsPerCycle() const;
+  double CacheMissRate() const;
+  double MemoryBytesPerSecond() const;
+  double CpuUtilization() const;
+
+ private:
+  static void Bump(std::atomic<uint64_t>& counter, const uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+  }
+
+  bool Has(const PerfCounters::Event event) const {
+    return (mask_.load(std::memory_order_relaxed) >> event) & 1;
+  }
+
+ private:
+  std::atomic<unsigned> mask_;  // События, доступные во всех замерах.
+  std::atomic<uint64_t> values_[PerfCounters::EventsCount];
+  std::atomic<uint64_t> generations_;
+  std::atomic<uint64_t> nanoseconds_;
+  std::atomic<uint64_t> cells_;
+};
@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <random>
+#include <thread>
+
+#include "bit_slice.hpp"
+#include "soup_engine.hpp"
+
+namespace {
+
+const size_t kPackSize = 64;
+
+bool IsPowerOfTwo(const size_t n) {
+  return n != 0 && (n & (n - 1)) == 0;
+}
+
+}  // namespace
+
+SoupEngine::SoupEngine(const Rules& rules, const size_t num_threads)
+    : num_threads_(std::max<size_t>(num_threads, 1)),
+      count_(0),
+      h_size_(0),
+      v_size_(0),
+      generations_(0),
+      density_(0),
+      seed_(0) {
+  for (int n = 0; n <= 8; ++n) {
+    born_[n] = rules.next_[0][n] ? ~uint64_t(0) : 0;
+    stay_[n] = rules.next_[1][n] ? ~uint64_t(0) : 0;
+    if (rules.next_[0][n] || rules.next_[1][n]) {
+      counts_.push_back(n);
+    }
+  }
+}
+
+std::vector<SoupResult> SoupEngine::Run(const size_t count,
+                                        const size_t h_size,
+                                        const size_t v_size,
+                                        const size_t generations,
+                                        const double density,
+                                        const unsigned seed) {
+  std::vector<SoupResult> results(count);
+  if (count == 0 || h_size == 0 || v_size == 0) {
+    return results;
+  }
+  count_ = count;
+  h_size_ = h_size;
+  v_size_ = v_size;
+  generations_ = generations;
+  density_ = density;
+  seed_ = seed;
+
+  // Пакеты раздаются потокам по одному: поля считаются разное число
+  // итераций, так нагрузка выравнивается сама.
+  size_t num_packs = (count + kPackSize - 1) / kPackSize;
+  std::atomic<size_t> next_pack(0);
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < std::min(num_threads_, num_packs); ++t) {
+    workers.emplace_back([&]() {
+      Workspace workspace;
+      for (size_t pack = next_pack++; pack < num_packs; pack = next_pack++) {
+        RunPack(pack, workspace, results);
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  return results;
+}
+
+void SoupEngine::RunPack(const size_t pack, Workspace& workspace,
+                         std::vector<SoupResult>& results) const {
+  size_t cells = h_size_ * v_size_;
+  size_t first = pack * kPackSize;
+  size_t lanes = std::min(kPackSize, count_ - first);
+  workspace.field_.assign(cells, 0);
+  workspace.new_field_.resize(cells);
+  workspace.sum0_.resize(cells);
+  workspace.sum1_.resize(cells);
+
+  // Поля заполняются в том же порядке, что и в GameOfLife::Start.
+  for (size_t k = 0; k < lanes; ++k) {
+    results[first + k].seed_ = seed_ + static_cast<unsigned>(first + k);
+    std::mt19937 rng(results[first + k].seed_);
+    std::bernoulli_distribution bern(density_);
+    for (size_t cell = 0; cell < cells; ++cell) {
+      if (bern(rng)) {
+        workspace.field_[cell] |= uint64_t(1) << k;
+      }
+    }
+  }
+
+  // Поля без найденного периода. Лишние биты последнего пакета не в счет.
+  uint64_t running = lanes == kPackSize ? ~uint64_t(0)
+                                        : (uint64_t(1) << lanes) - 1;
+  workspace.snapshot_ = workspace.field_;
+  size_t snapshot_generation = 0;
+  for (size_t generation = 1; generation <= generations_ && running;
+       ++generation) {
+    Step(workspace);
+    workspace.field_.swap(workspace.new_field_);
+
+    // Биты полей, отличающихся от снимка. Сравнение обрывается, как только
+    // отличаются все еще идущие поля.
+    uint64_t differ = 0;
+    for (size_t cell = 0; cell < cells && (differ & running) != running;
+         ++cell) {
+      differ |= workspace.field_[cell] ^ workspace.snapshot_[cell];
+    }
+    uint64_t settled = running & ~differ;
+    if (settled) {
+      CountPopulation(workspace.field_, settled, results, first);
+      for (uint64_t bits = settled; bits; bits &= bits - 1) {
+        SoupResult& result = results[first + __builtin_ctzll(bits)];
+        result.period_ = generation - snapshot_generation;
+        result.settled_at_ = generation;
+        result.died_ = result.population_ == 0;
+      }
+      running &= ~settled;
+    }
+    if (IsPowerOfTwo(generation)) {
+      workspace.snapshot_ = workspace.field_;
+      snapshot_generation = generation;
+    }
+  }
+  if (running) {
+    CountPopulation(workspace.field_, running, results, first);
+    for (uint64_t bits = running; bits; bits &= bits - 1) {
+      SoupResult& result = results[first + __builtin_ctzll(bits)];
+      result.settled_at_ = generations_;
+      result.died_ = result.population_ == 0;
+    }
+  }
+}
+
+void SoupEngine::Step(Workspace& workspace) const {
+  const Pack& field = workspace.field_;
+  Pack& new_field = workspace.new_field_;
+  size_t width = v_size_;
+
+  // Сумма каждой клетки с соседями слева и справа, общая для трех строк.
+  for (size_t i = 0; i < h_size_; ++i) {
+    const uint64_t* row = field.data() + i * width;
+    uint64_t* sum0 = workspace.sum0_.data() + i * width;
+    uint64_t* sum1 = workspace.sum1_.data() + i * width;
+    for (size_t j = 0; j < width; ++j) {
+      uint64_t left = row[j == 0 ? width - 1 : j - 1];
+      uint64_t right = row[j + 1 == width ? 0 : j + 1];
+      FullAdd(left, row[j], right, sum0[j], sum1[j]);
+    }
+  }
+
+  for (size_t i = 0; i < h_size_; ++i) {
+    size_t up_row = (i == 0 ? h_size_ - 1 : i - 1) * width;
+    size_t down_row = (i + 1 == h_size_ ? 0 : i + 1) * width;
+    const uint64_t* row = field.data() + i * width;
+    const uint64_t* up0 = workspace.sum0_.data() + up_row;
+    const uint64_t* up1 = workspace.sum1_.data() + up_row;
+    const uint64_t* down0 = workspace.sum0_.data() + down_row;
+    const uint64_t* down1 = workspace.sum1_.data() + down_row;
+    uint64_t* out = new_field.data() + i * width;
+    for (size_t j = 0; j < width; ++j) {
+      uint64_t left = row[j == 0 ? width - 1 : j - 1];
+      uint64_t right = row[j + 1 == width ? 0 : j + 1];
+      uint64_t alive = row[j];
+
+      // Соседи: сумма строки сверху (0..3) + снизу (0..3) + слева и справа
+      // (0..2), по битам n0..n3.
+      uint64_t mid0 = left ^ right;
+      uint64_t mid1 = left & right;
+      uint64_t n0, carry0, n1, carry1;
+      FullAdd(up0[j], down0[j], mid0, n0, carry0);
+      // Вес 2: up1 + down1 + mid1 + carry0, от 0 до 4.
+      uint64_t s, c;
+      FullAdd(up1[j], down1[j], mid1, s, c);
+      n1 = s ^ carry0;
+      carry1 = s & carry0;
+      // Вес 4: c + carry1, перенос из него - в вес 8.
+      uint64_t n2 = c ^ carry1;
+      uint64_t n3 = c & carry1;
+
+      uint64_t next = 0;
+      for (int n : counts_) {
+        uint64_t equal = (n & 1 ? n0 : ~n0) & (n & 2 ? n1 : ~n1) &
+                         (n & 4 ? n2 : ~n2) & (n & 8 ? n3 : ~n3);
+        next |= equal & ((alive & stay_[n]) | (~alive & born_[n]));
+      }
+      out[j] = next;
+    }
+  }
+}
+
+void SoupEngine::CountPopulation(const Pack& field, const uint64_t lanes,
+                                 std::vector<SoupResult>& results,
+                                 const size_t first) const {
+  long long population[kPackSize] = {};
+  for (auto word : field) {
+    for (uint64_t bits = word & lanes; bits; bits &= bits - 1) {
+      ++population[__builtin_ctzll(bits)];
+    }
+  }
+  for (uint64_t bits = lanes; bits; bits &= bits - 1) {
+    size_t k = __builtin_ctzll(bits);
+    results[first + k].population_ = population[k];
+  }
+}
+
+void SoupEngine::PrintSummary(const std::vector<SoupResult>& results,
+                              std::ostream& out) {
+  size_t died = 0;
+  size_t unsettled = 0;
+  std::map<size_t, size_t> periods;
+  for (const auto& result : results) {
+    if (result.died_) {
+      ++died;
+    } else if (result.period_ == 0) {
+      ++unsettled;
+    } else {
+      ++periods[result.period_];
+    }
+  }
+  out << "Boards: " << results.size() << ", died: " << died
+      << ", not settled: " << unsettled << "\n";
+  for (const auto& period : periods) {
+    out << "\tperiod " << period.first << ": " << period.second << "\n";
+  }
+}
+
+void SoupEngine::PrintCsv(const std::vector<SoupResult>& results,
+                          std::ostream& out) {
+  out << "seed,population,period,settled_at,died\n";
+  for (const auto& result : results) {
+    out << result.seed_ << "," << result.population_ << "," << result.period_
+        << "," << result.settled_at_ << "," << (result.died_ ? 1 : 0) << "\n";
+  }
+}
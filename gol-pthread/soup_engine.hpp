@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <ostream>
+#include <vector>
+
+#include "rules.hpp"
+
+// Итог расчета одного поля.
+struct SoupResult {
+  unsigned seed_ = 0;         // Зерно, из которого получено поле.
+  long long population_ = 0;  // Живых клеток на последней итерации поля.
+  size_t period_ = 0;         // Период, в который пришло поле, 0 - не пришло.
+  size_t settled_at_ = 0;     // Итерация, на которой найден период.
+  bool died_ = false;         // Вымерло ли поле.
+};
+
+// Расчет множества маленьких независимых полей ("супов"). Поля пакуются по
+// 64: слово клетки хранит ее состояние во всех полях пакета, и итерация
+// считается побитовыми операциями сразу для всего пакета. Пакеты разбирает
+// фиксированное число потоков. Период ищется методом Брента сравнением со
+// снимком пакета на итерациях-степенях двойки, пакет перестает считаться,
+// когда период найден во всех его полях.
+class SoupEngine {
+ public:
+  SoupEngine(const Rules& rules, const size_t num_threads);
+
+  // Расчет count случайных полей h_size x v_size, не больше generations
+  // итераций каждое. Поле k совпадает с GameOfLife::Start(h_size, v_size,
+  // density, seed + k).
+  std::vector<SoupResult> Run(const size_t count, const size_t h_size,
+                              const size_t v_size, const size_t generations,
+                              const double density, const unsigned seed);
+
+  // Сводка итогов: сколько полей вымерло, пришло в какой период и не пришло.
+  static void PrintSummary(const std::vector<SoupResult>& results,
+                           std::ostream& out);
+
+  // Итоги по полю на строку в формате CSV.
+  static void PrintCsv(const std::vector<SoupResult>& results,
+                       std::ostream& out);
+
+ private:
+  // Пакет полей: слово на клетку, бит k - клетка поля k пакета.
+  using Pack = std::vector<uint64_t>;
+
+  // Буферы потока, переиспользуемые между пакетами.
+  struct Workspace {
+    Pack field_;
+    Pack new_field_;
+    Pack snapshot_;
+    Pack sum0_;  // Младший и старший биты суммы клетки
+    Pack sum1_;  // с соседями слева и справа.
+  };
+
+  void RunPack(const size_t pack, Workspace& workspace,
+               std::vector<SoupResult>& results) const;
+
+  // Одна итерация пакета из workspace.field_ в workspace.new_field_.
+  void Step(Workspace& workspace) const;
+
+  // Запись в population_ полей lanes числа их живых клеток.
+  void CountPopulation(const Pack& field, const uint64_t lanes,
+                       std::vector<SoupResult>& results,
+                       const size_t first) const;
+
+ private:
+  // Маски правил: все единицы, если при n соседях клетка рождается
+  // (остается жить), иначе нули.
+  uint64_t born_[9];
+  uint64_t stay_[9];
+  std::vector<int> counts_;  // Числа соседей, при которых клетка жива.
+  size_t num_threads_;
+
+  size_t count_;
+  size_t h_size_;
+  size_t v_size_;
+  size_t generations_;
+  double density_;
+  unsigned seed_;
+};
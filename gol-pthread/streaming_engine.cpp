@@ -0,0 +1,280 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "field_io.hpp"
+#include "streaming_engine.hpp"
+
+namespace {
+
+bool ReadFully(const int fd, void* data, size_t size, off_t offset) {
+  char* out = static_cast<char*>(data);
+  while (size > 0) {
+    ssize_t count = pread(fd, out, size, offset);
+    if (count <= 0) {
+      return false;
+    }
+    out += count;
+    size -= count;
+    offset += count;
+  }
+  return true;
+}
+
+bool WriteFully(const int fd, const void* data, size_t size, off_t offset) {
+  const char* in = static_cast<const char*>(data);
+  while (size > 0) {
+    ssize_t count = pwrite(fd, in, size, offset);
+    if (count <= 0) {
+      return false;
+    }
+    in += count;
+    size -= count;
+    offset += count;
+  }
+  return true;
+}
+
+}  // namespace
+
+StreamingEngine::StreamingEngine(const Rules& rules, const size_t num_threads,
+                                 const size_t band_rows,
+                                 const size_t generations_per_pass)
+    : num_threads_(std::max<size_t>(num_threads, 1)),
+      band_rows_(std::max<size_t>(band_rows, 1)),
+      generations_per_pass_(std::max<size_t>(generations_per_pass, 1)),
+      height_(0),
+      width_(0),
+      row_size_(0) {
+  std::memcpy(next_state_, rules.next_, sizeof(next_state_));
+}
+
+bool StreamingEngine::Run(const std::string& input, const std::string& output,
+                          const size_t generations, const std::string& rules) {
+  int in_fd = open(input.c_str(), O_RDONLY);
+  if (in_fd < 0) {
+    return false;
+  }
+  BoardHeader header;
+  struct stat st;
+  if (!ReadFully(in_fd, &header, sizeof(header), 0) ||
+      !IsValidBoardHeader(header) || header.encoding_ != BoardHeader::Bits ||
+      fstat(in_fd, &st) != 0 ||
+      (static_cast<size_t>(st.st_size) - sizeof(header)) /
+              ((header.width_ + 7) / 8) < header.height_) {
+    close(in_fd);
+    return false;
+  }
+  height_ = header.height_;
+  width_ = header.width_;
+  row_size_ = (width_ + 7) / 8;
+
+  // Без O_TRUNC: output может оказаться тем же файлом, что и input.
+  int out_fd = open(output.c_str(), O_RDWR | O_CREAT, 0644);
+  if (out_fd < 0) {
+    close(in_fd);
+    return false;
+  }
+  bool ok = ftruncate(out_fd, sizeof(header) + height_ * row_size_) == 0;
+
+  // Первый проход читает input, следующие считают output на месте. Даже
+  // при generations = 0 строки переносятся в output.
+  const size_t band_rows = band_rows_;
+  band_rows_ = std::min(band_rows_, height_);
+  size_t done = 0;
+  do {
+    size_t steps = std::min({generations - done, generations_per_pass_,
+                             band_rows_});
+    ok = ok && Pass(done == 0 ? in_fd : out_fd, out_fd, steps);
+    done += steps;
+  } while (ok && done < generations);
+  band_rows_ = band_rows;
+
+  FillBoardHeader(header, height_, width_, rules,
+                  header.generation_ + generations, true);
+  ok = ok && WriteFully(out_fd, &header, sizeof(header), 0);
+  window_.clear();
+  window_.shrink_to_fit();
+  new_window_.clear();
+  new_window_.shrink_to_fit();
+  close(in_fd);
+  return close(out_fd) == 0 && ok;
+}
+
+bool StreamingEngine::Pass(const int in_fd, const int out_fd,
+                           const size_t steps) {
+  const size_t bands_count = (height_ + band_rows_ - 1) / band_rows_;
+
+  // Крайним полосам нужны строки с другого края поля. Они читаются до того,
+  // как проход на месте перезапишет их.
+  Band head;
+  Band tail;
+  bool ok = ReadRows(in_fd, 0, steps, head) &&
+            ReadRows(in_fd, height_ - steps, steps, tail);
+
+  // Окно из трех полос: prev, cur и next. Полоса после next читается
+  // заранее в prefetched, посчитанная полоса пишется из writing.
+  Band prev;
+  Band cur;
+  Band next;
+  Band prefetched;
+  Band result;
+  Band writing;
+  ok = ok && ReadRows(in_fd, BandBegin(0), BandRows(0), cur) &&
+       (bands_count < 2 || ReadRows(in_fd, BandBegin(1), BandRows(1), next));
+  bool read_ok = true;
+  bool write_ok = true;
+  std::thread reader;
+  std::thread writer;
+  if (ok && bands_count > 2) {
+    reader = std::thread([&]() {
+      read_ok = ReadRows(in_fd, BandBegin(2), BandRows(2), prefetched);
+    });
+  }
+
+  for (size_t band = 0; ok && band < bands_count; ++band) {
+    const size_t begin = BandBegin(band);
+    const size_t rows = BandRows(band);
+    const size_t window_rows = rows + 2 * steps;
+
+    // Исходная строка row поля из полос окна или крайних строк.
+    auto find_row = [&](const size_t row) -> const unsigned char* {
+      if (row >= begin && row < begin + rows) {
+        return cur.data() + (row - begin) * row_size_;
+      }
+      if (band > 0 && row >= BandBegin(band - 1) && row < begin) {
+        return prev.data() + (row - BandBegin(band - 1)) * row_size_;
+      }
+      if (band + 1 < bands_count && row >= begin + rows &&
+          row < begin + rows + BandRows(band + 1)) {
+        return next.data() + (row - begin - rows) * row_size_;
+      }
+      if (row < steps) {
+        return head.data() + row * row_size_;
+      }
+      return tail.data() + (row - (height_ - steps)) * row_size_;
+    };
+
+    window_.resize(window_rows * width_);
+    new_window_.resize(window_rows * width_);
+    for (size_t i = 0; i < window_rows; ++i) {
+      const unsigned char* row =
+          find_row((begin + height_ - steps + i) % height_);
+      char* cells = window_.data() + i * width_;
+      for (size_t j = 0; j < width_; ++j) {
+        cells[j] = (row[j / 8] >> (j % 8)) & 1;
+      }
+    }
+
+    // После итерации s верны строки окна [s, window_rows - s).
+    for (size_t s = 1; s <= steps; ++s) {
+      const size_t first = s;
+      const size_t last = window_rows - s;
+      const size_t num_threads = std::min(num_threads_, last - first);
+      std::vector<std::thread> workers;
+      for (size_t t = 1; t < num_threads; ++t) {
+        workers.emplace_back(&StreamingEngine::StepRows, this,
+                             first + (last - first) * t / num_threads,
+                             first + (last - first) * (t + 1) / num_threads);
+      }
+      StepRows(first, first + (last - first) / num_threads);
+      for (auto& worker : workers) {
+        worker.join();
+      }
+      window_.swap(new_window_);
+    }
+
+    result.assign(rows * row_size_, 0);
+    for (size_t i = 0; i < rows; ++i) {
+      const char* cells = window_.data() + (steps + i) * width_;
+      unsigned char* row = result.data() + i * row_size_;
+      for (size_t j = 0; j < width_; ++j) {
+        row[j / 8] |= static_cast<unsigned char>(cells[j] << (j % 8));
+      }
+    }
+
+    if (writer.joinable()) {
+      writer.join();
+    }
+    ok = write_ok;
+    writing.swap(result);
+    writer = std::thread([&, begin]() {
+      write_ok = WriteRows(out_fd, begin, writing);
+    });
+
+    if (reader.joinable()) {
+      reader.join();
+    }
+    ok = ok && read_ok;
+    prev.swap(cur);
+    cur.swap(next);
+    next.swap(prefetched);
+    if (ok && band + 3 < bands_count) {
+      reader = std::thread([&, band]() {
+        read_ok = ReadRows(in_fd, BandBegin(band + 3), BandRows(band + 3),
+                           prefetched);
+      });
+    }
+  }
+
+  if (reader.joinable()) {
+    reader.join();
+  }
+  if (writer.joinable()) {
+    writer.join();
+  }
+  return ok && read_ok && write_ok;
+}
+
+size_t StreamingEngine::BandBegin(const size_t band) const {
+  return band * band_rows_;
+}
+
+size_t StreamingEngine::BandRows(const size_t band) const {
+  return std::min(band_rows_, height_ - BandBegin(band));
+}
+
+bool StreamingEngine::ReadRows(const int fd, const size_t begin,
+                               const size_t rows, Band& band) const {
+  band.resize(rows * row_size_);
+  return ReadFully(fd, band.data(), band.size(),
+                   sizeof(BoardHeader) + begin * row_size_);
+}
+
+bool StreamingEngine::WriteRows(const int fd, const size_t begin,
+                                const Band& band) const {
+  return WriteFully(fd, band.data(), band.size(),
+                    sizeof(BoardHeader) + begin * row_size_);
+}
+
+void StreamingEngine::StepRows(const size_t begin, const size_t end) {
+  const size_t width = width_;
+  for (size_t i = begin; i < end; ++i) {
+    const char* up = window_.data() + (i - 1) * width;
+    const char* mid = up + width;
+    const char* down = mid + width;
+    char* out = new_window_.data() + i * width;
+
+    // Крайние столбцы замыкаются через край строки.
+    auto wrapped = [&](const size_t j) {
+      size_t left = j == 0 ? width - 1 : j - 1;
+      size_t right = j + 1 == width ? 0 : j + 1;
+      int num_alive = up[left] + up[j] + up[right] + mid[left] + mid[right] +
+                      down[left] + down[j] + down[right];
+      out[j] = next_state_[static_cast<size_t>(mid[j])][num_alive];
+    };
+    wrapped(0);
+    for (size_t j = 1; j + 1 < width; ++j) {
+      int num_alive = up[j - 1] + up[j] + up[j + 1] + mid[j - 1] +
+                      mid[j + 1] + down[j - 1] + down[j] + down[j + 1];
+      out[j] = next_state_[static_cast<size_t>(mid[j])][num_alive];
+    }
+    if (width > 1) {
+      wrapped(width - 1);
+    }
+  }
+}
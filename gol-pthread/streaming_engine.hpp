@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+
+#include <string>
+#include <vector>
+
+#include "rules.hpp"
+
+// Расчет поля, которое не помещается в память. Поле лежит в двоичном файле
+// по биту на клетку и проходит через память полосами по band_rows строк.
+// Полоса считается в окне из нее самой и строк соседних полос, за один
+// проход по файлу поле продвигается на generations_per_pass итераций.
+// Следующая полоса читается, а посчитанная пишется фоновыми потоками, пока
+// считается текущая.
+class StreamingEngine {
+ public:
+  StreamingEngine(const Rules& rules, const size_t num_threads,
+                  const size_t band_rows, const size_t generations_per_pass);
+
+  // Расчет generations итераций поля из двоичного файла input. Результат
+  // с правилами rules и номером итерации пишется в output. Если output
+  // совпадает с input, поле считается на месте.
+  bool Run(const std::string& input, const std::string& output,
+           const size_t generations, const std::string& rules);
+
+ private:
+  // Полоса строк по биту на клетку, как в файле.
+  using Band = std::vector<unsigned char>;
+
+  // Проход по файлу: строки in_fd, продвинутые на steps итераций, пишутся
+  // в out_fd. Файлы могут совпадать.
+  bool Pass(const int in_fd, const int out_fd, const size_t steps);
+
+  size_t BandBegin(const size_t band) const;
+  size_t BandRows(const size_t band) const;
+
+  bool ReadRows(const int fd, const size_t begin, const size_t rows,
+                Band& band) const;
+  bool WriteRows(const int fd, const size_t begin, const Band& band) const;
+
+  // Одна итерация строк окна [begin, end) из window_ в new_window_.
+  void StepRows(const size_t begin, const size_t end);
+
+ private:
+  char next_state_[2][9];  // Новое состояние по старому и числу соседей.
+  size_t num_threads_;
+  size_t band_rows_;
+  size_t generations_per_pass_;
+
+  size_t height_;
+  size_t width_;
+  size_t row_size_;  // Байт на строку в файле.
+
+  // Окно полосы по байту на клетку.
+  std::vector<char> window_;
+  std::vector<char> new_window_;
+};
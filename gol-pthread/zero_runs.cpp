@@ -0,0 +1,71 @@
+#include <cstdint>
+#include <cstring>
+
+#include "zero_runs.hpp"
+
+namespace {
+
+void PutVarint(size_t value, std::vector<unsigned char>& out) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<unsigned char>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<unsigned char>(value));
+}
+
+const unsigned char* GetVarint(const unsigned char* data, size_t& value) {
+  value = 0;
+  for (size_t shift = 0;; shift += 7) {
+    value |= static_cast<size_t>(*data & 0x7f) << shift;
+    if (!(*data++ & 0x80)) {
+      return data;
+    }
+  }
+}
+
+}  // namespace
+
+// Нули пропускаются по 8 байт за раз, так что неизменившиеся участки
+// разностного кадра почти ничего не стоят.
+void EncodeZeroRuns(const std::vector<unsigned char>& data,
+                    std::vector<unsigned char>& out) {
+  out.clear();
+  const size_t size = data.size();
+  size_t i = 0;
+  while (i < size) {
+    size_t zeros_begin = i;
+    uint64_t word = 0;
+    while (i + sizeof(word) <= size &&
+           (std::memcpy(&word, &data[i], sizeof(word)), word == 0)) {
+      i += sizeof(word);
+    }
+    while (i < size && data[i] == 0) {
+      ++i;
+    }
+    // Одиночный ноль выгоднее оставить внутри ненулевых байт.
+    size_t literal_begin = i;
+    while (i < size && (data[i] != 0 || (i + 1 < size && data[i + 1] != 0))) {
+      ++i;
+    }
+    PutVarint(literal_begin - zeros_begin, out);
+    PutVarint(i - literal_begin, out);
+    out.insert(out.end(), data.begin() + literal_begin, data.begin() + i);
+  }
+}
+
+void ApplyZeroRuns(const std::vector<unsigned char>& encoded,
+                   std::vector<unsigned char>& data) {
+  const unsigned char* in = encoded.data();
+  const unsigned char* end = in + encoded.size();
+  size_t position = 0;
+  while (in < end) {
+    size_t zeros = 0;
+    size_t literals = 0;
+    in = GetVarint(in, zeros);
+    in = GetVarint(in, literals);
+    position += zeros;
+    for (size_t i = 0; i < literals; ++i) {
+      data[position++] ^= *in++;
+    }
+  }
+}
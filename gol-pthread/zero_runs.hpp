@@ -0,0 +1,14 @@
+#pragma once
+
+#include <vector>
+
+// Сжатие по сериям нулевых байт: пары varint (длина серии нулей, число
+// следующих ненулевых байт), за каждой парой идут сами байты. Подходит для
+// разностей соседних поколений, где почти все байты нулевые.
+void EncodeZeroRuns(const std::vector<unsigned char>& data,
+                    std::vector<unsigned char>& out);
+
+// Наложение сжатых данных на data через XOR. data должен быть размера
+// исходных данных; если он нулевой, в нем оказываются сами данные.
+void ApplyZeroRuns(const std::vector<unsigned char>& encoded,
+                   std::vector<unsigned char>& data);
@@ -0,0 +1,119 @@
+#!/bin/bash
+# Сравнение вывода движков с эталонами из каталога golden: поле soup.csv
+# проводится через несколько итераций, итоговое поле (его контрольная
+# сумма) и сводки итераций должны совпасть с сохраненными. gol_pthread
+# запускается в пакетном режиме с одним и несколькими потоками, gol_mpi -
+# интерактивно во всех режимах обмена границами, которые пакетный режим не
+# выбирает. Сводка итерации 0 при сравнении отбрасывается: ее пишет только
+# gol_mpi.
+
+usage() {
+  cat <<EOF
+Usage: $0 [--pthread <path>] [--mpi <path>] [options]
+Options:
+  --launcher <command>      mpi launcher, -np is appended (mpirun)
+  --procs <n>               mpi ranks including the master (3)
+  --update                  rewrite the expected outputs with gol_pthread
+                            instead of comparing
+At least one binary is required. Exits with 1 if any output differs.
+EOF
+}
+
+pthread=""
+mpi=""
+launcher="mpirun"
+procs=3
+update=0
+
+while [ $# -gt 0 ]; do
+  case "$1" in
+    --update) update=1; shift; continue ;;
+  esac
+  if [ $# -lt 2 ]; then
+    usage >&2
+    exit 1
+  fi
+  case "$1" in
+    --pthread) pthread="$2" ;;
+    --mpi) mpi="$2" ;;
+    --launcher) launcher="$2" ;;
+    --procs) procs="$2" ;;
+    *) usage >&2; exit 1 ;;
+  esac
+  shift 2
+done
+
+if [ -z "$pthread" ] && [ -z "$mpi" ] ||
+   [ -n "$pthread" ] && [ ! -x "$pthread" ] ||
+   [ -n "$mpi" ] && [ ! -x "$mpi" ] ||
+   [ "$update" -eq 1 ] && [ -z "$pthread" ]; then
+  usage >&2
+  exit 1
+fi
+
+golden=$(cd "$(dirname "$0")" && pwd)/golden
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+
+# Случаи: имя, правила, число итераций. Правила Generations считает только
+# gol_pthread.
+cases="life b3/s23 60
+ltl r2,c0,m1,s3..6,b4..5,nm 60
+brain b2/s/c3 60
+star-wars b2/s345/c4 60"
+generations_case() {
+  case "$1" in
+    brain|star-wars) return 0 ;;
+  esac
+  return 1
+}
+
+failed=0
+
+# Сравнение поля $work/out.bin и сводок $work/out.csv с эталоном случая.
+check() {
+  local name=$1 label=$2
+  grep -v '^0,' "$work/out.csv" > "$work/census.csv"
+  if cmp -s "$work/census.csv" "$golden/$name.csv" &&
+     [ "$(cksum < "$work/out.bin")" = "$(cat "$golden/$name.cksum")" ]; then
+    echo "ok: $label"
+  else
+    echo "FAILED: $label"
+    failed=1
+  fi
+}
+
+while read name rules generations; do
+  if [ "$update" -eq 1 ]; then
+    "$pthread" --input "$golden/soup.csv" --generations "$generations" \
+        --output "$work/out.bin" --census "$work/out.csv" --threads 1 \
+        --rules "$rules" > /dev/null || exit 1
+    cp "$work/out.csv" "$golden/$name.csv"
+    cksum < "$work/out.bin" > "$golden/$name.cksum"
+    echo "updated: $name"
+    continue
+  fi
+
+  if [ -n "$pthread" ]; then
+    for threads in 1 3; do
+      rm -f "$work/out.bin" "$work/out.csv"
+      "$pthread" --input "$golden/soup.csv" --generations "$generations" \
+          --output "$work/out.bin" --census "$work/out.csv" \
+          --threads "$threads" --rules "$rules" > /dev/null
+      check "$name" "pthread $name, $threads threads"
+    done
+  fi
+
+  if [ -n "$mpi" ] && ! generations_case "$name"; then
+    for halo in two-sided rma no-shm sparse; do
+      rm -f "$work/out.bin" "$work/out.csv"
+      printf "start %s\ncensus record %s\nrun %s\nwait\nsave %s\nquit\n" \
+          "$golden/soup.csv" "$work/out.csv" "$generations" \
+          "$work/out.bin" |
+          $launcher -np "$procs" "$mpi" "$rules" $halo > /dev/null
+      check "$name" "mpi $name, $halo"
+    done
+  fi
+done <<< "$cases"
+
+exit $failed
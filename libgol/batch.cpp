@@ -0,0 +1,124 @@
+#include <chrono>
+#include <sstream>
+
+#include "batch.hpp"
+
+namespace {
+
+bool ParseNumber(const std::string& str, size_t& value) {
+  if (str.empty() || str.find_first_not_of("0123456789") != std::string::npos) {
+    return false;
+  }
+  std::istringstream in(str);
+  return static_cast<bool>(in >> value);
+}
+
+// Размер вида <строки>x<столбцы>.
+bool ParseSize(const std::string& str, size_t& rows, size_t& columns) {
+  size_t separator = str.find('x');
+  return separator != std::string::npos &&
+         ParseNumber(str.substr(0, separator), rows) &&
+         ParseNumber(str.substr(separator + 1), columns) && rows > 0 &&
+         columns > 0;
+}
+
+}  // namespace
+
+bool IsBatchMode(int argc, char** argv) {
+  return argc >= 2 && std::string(argv[1]).compare(0, 2, "--") == 0;
+}
+
+void PrintBatchHelp(std::ostream& out) {
+  out << "Batch mode arguments:\n"
+         "\t--input <filename> - field to start from (.csv, .rle or binary "
+         "field\n\t\tsaved with save); binary fields and .rle patterns keep "
+         "their rules\n"
+         "\t--size <n>x<m> - random field sized (n x m) if there is no "
+         "input,\n\t\tminimal field size for an .rle pattern otherwise\n"
+         "\t--generations <n> - iterations to run (0)\n"
+         "\t--output <filename> - save the final field to a binary file\n"
+         "\t--census <filename> - write census of every iteration to a .csv "
+         "file\n"
+         "\t--threads <k> - number of threads, gol_pthread only (4)\n"
+         "\t--rules <rules> - game rules (b3/s23); Generations rules "
+         "such as b2/s/c3\n\t\tare run by gol_pthread, the field is saved "
+         "a byte per cell\n";
+}
+
+bool ParseBatchOptions(int argc, char** argv, BatchOptions& options,
+                       std::ostream& err) {
+  for (int i = 1; i < argc; i += 2) {
+    std::string key = argv[i];
+    if (key == "--help") {
+      return false;
+    }
+    if (i + 1 >= argc) {
+      err << "Missing value of " << key << "\n";
+      return false;
+    }
+    std::string value = argv[i + 1];
+    bool correct = true;
+    if (key == "--input") {
+      options.input = value;
+    } else if (key == "--size") {
+      correct = ParseSize(value, options.rows, options.columns);
+    } else if (key == "--generations") {
+      correct = ParseNumber(value, options.generations);
+    } else if (key == "--output") {
+      options.output = value;
+    } else if (key == "--census") {
+      options.census = value;
+    } else if (key == "--threads") {
+      correct = ParseNumber(value, options.threads) && options.threads > 0;
+    } else if (key == "--rules") {
+      options.rules = value;
+    } else {
+      correct = false;
+    }
+    if (!correct) {
+      err << "Invalid argument " << key << " " << value << "\n";
+      return false;
+    }
+  }
+  if (options.input.empty() && options.rows == 0) {
+    err << "Either --input or --size should be given\n";
+    return false;
+  }
+  return true;
+}
+
+int RunBatch(Engine& engine, const BatchOptions& options, std::ostream& out,
+             std::ostream& err) {
+  bool started = options.input.empty()
+                     ? engine.Start(options.rows, options.columns)
+                     : engine.Start(options.input, options.rows,
+                                    options.columns);
+  if (!started) {
+    err << "Could not create the field\n";
+    engine.Quit();
+    return 1;
+  }
+  if (!options.census.empty() && !engine.RecordCensus(options.census)) {
+    err << "Could not open " << options.census << "\n";
+    engine.Quit();
+    return 1;
+  }
+
+  auto begin = std::chrono::steady_clock::now();
+  if (options.generations > 0) {
+    engine.Run(options.generations);
+    engine.Wait();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - begin;
+
+  int code = 0;
+  if (!options.output.empty() && !engine.Save(options.output)) {
+    err << "Could not save " << options.output << "\n";
+    code = 1;
+  }
+  engine.Quit();
+  out << "Finished " << options.generations << " iterations in "
+      << elapsed.count() << " s.\n";
+  return code;
+}
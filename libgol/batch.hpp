@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+
+#include <ostream>
+#include <string>
+
+#include "engine.hpp"
+
+// Параметры пакетного режима: поле проводится через generations итераций
+// без чтения команд и вывода поля.
+struct BatchOptions {
+  std::string input;      // Файл поля. Если пуст, поле случайное.
+  size_t rows = 0;        // Размер случайного поля или минимальный размер
+  size_t columns = 0;     // поля для паттерна RLE.
+  size_t generations = 0;
+  std::string output;     // Двоичный файл итогового поля.
+  std::string census;     // Файл CSV со сводками итераций.
+  size_t threads = 4;
+  std::string rules = "b3/s23";
+};
+
+// Пакетный ли режим: аргументы программы начинаются с --.
+bool IsBatchMode(int argc, char** argv);
+
+// Разбор аргументов пакетного режима. Ошибки выводятся в err. На --help
+// возвращает false.
+bool ParseBatchOptions(int argc, char** argv, BatchOptions& options,
+                       std::ostream& err);
+
+void PrintBatchHelp(std::ostream& out);
+
+// Выполнение задания на движке. Движок завершается. Возвращает код выхода
+// программы.
+int RunBatch(Engine& engine, const BatchOptions& options, std::ostream& out,
+             std::ostream& err);
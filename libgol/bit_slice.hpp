@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+// Полный сумматор по битам: сумма a + b + c как sum + 2 * carry. Нужен
+// движкам, которые считают соседей сразу для 64 клеток слова.
+inline void FullAdd(const uint64_t a, const uint64_t b, const uint64_t c,
+                    uint64_t& sum, uint64_t& carry) {
+  uint64_t half = a ^ b;
+  sum = half ^ c;
+  carry = (a & b) | (half & c);
+}
@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <iomanip>
+
+#include "census.hpp"
+
+const size_t Census::kSavedSize;
+const size_t CensusLog::kHistorySize;
+
+void Census::Merge(const Census& other) {
+  population_ += other.population_;
+  births_ += other.births_;
+  deaths_ += other.deaths_;
+  if (other.min_row_ <= other.max_row_) {
+    AddRow(other.min_row_, other.min_col_, other.max_col_);
+    AddRow(other.max_row_, other.min_col_, other.max_col_);
+  }
+}
+
+void Census::Save(long long* data) const {
+  data[0] = static_cast<long long>(generation_);
+  data[1] = static_cast<long long>(population_);
+  data[2] = static_cast<long long>(births_);
+  data[3] = static_cast<long long>(deaths_);
+  data[4] = min_row_;
+  data[5] = max_row_;
+  data[6] = min_col_;
+  data[7] = max_col_;
+}
+
+void Census::Load(const long long* data) {
+  generation_ = static_cast<uint64_t>(data[0]);
+  population_ = static_cast<uint64_t>(data[1]);
+  births_ = static_cast<uint64_t>(data[2]);
+  deaths_ = static_cast<uint64_t>(data[3]);
+  min_row_ = data[4];
+  max_row_ = data[5];
+  min_col_ = data[6];
+  max_col_ = data[7];
+}
+
+void Census::PrintCsvHeader(std::ostream& out) {
+  out << "generation,population,births,deaths,min_row,max_row,min_col,"
+         "max_col\n";
+}
+
+void Census::PrintCsv(std::ostream& out) const {
+  out << generation_ << "," << population_ << "," << births_ << ","
+      << deaths_;
+  // Пустой прямоугольник выводится пустыми полями.
+  if (min_row_ <= max_row_) {
+    out << "," << min_row_ << "," << max_row_ << "," << min_col_ << ","
+        << max_col_ << "\n";
+  } else {
+    out << ",,,,\n";
+  }
+}
+
+Census CountCensus(const CyclicVector<CyclicVector<char>>& field,
+                   const long long begin, const long long end,
+                   const long long offset) {
+  Census census;
+  for (long long i = begin; i < end; ++i) {
+    const char* cells = field[i].data();
+    long long width = static_cast<long long>(field[i].size());
+    long long first = -1;
+    long long last = -1;
+    for (long long j = 0; j < width; ++j) {
+      if (cells[j]) {
+        first = first < 0 ? j : first;
+        last = j;
+        ++census.population_;
+      }
+    }
+    if (first >= 0) {
+      census.AddRow(i + offset, first, last);
+    }
+  }
+  return census;
+}
+
+void CensusLog::Clear() {
+  history_.clear();
+}
+
+void CensusLog::Add(const Census& census) {
+  if (history_.size() == kHistorySize) {
+    history_.pop_front();
+  }
+  history_.push_back(census);
+  if (file_.is_open()) {
+    census.PrintCsv(file_);
+  }
+}
+
+bool CensusLog::Record(const std::string& filename) {
+  StopRecording();
+  file_.open(filename);
+  if (!file_.is_open()) {
+    return false;
+  }
+  Census::PrintCsvHeader(file_);
+  return true;
+}
+
+void CensusLog::StopRecording() {
+  if (file_.is_open()) {
+    file_.close();
+  }
+}
+
+void CensusLog::Print(std::ostream& out, const size_t count) const {
+  out << std::setw(12) << "generation" << std::setw(14) << "population"
+      << std::setw(10) << "births" << std::setw(10) << "deaths"
+      << "  bounding box (rows x columns)\n";
+  size_t shown = std::min(count, history_.size());
+  for (size_t i = history_.size() - shown; i < history_.size(); ++i) {
+    const Census& census = history_[i];
+    out << std::setw(12) << census.generation_ << std::setw(14)
+        << census.population_ << std::setw(10) << census.births_
+        << std::setw(10) << census.deaths_ << "  ";
+    if (census.min_row_ <= census.max_row_) {
+      out << "[" << census.min_row_ << ", " << census.max_row_ << "] x ["
+          << census.min_col_ << ", " << census.max_col_ << "]\n";
+    } else {
+      out << "empty\n";
+    }
+  }
+}
+
+void CensusLog::Save(const size_t count, std::vector<long long>& out) const {
+  size_t shown = std::min(count, history_.size());
+  for (size_t i = history_.size() - shown; i < history_.size(); ++i) {
+    out.resize(out.size() + Census::kSavedSize);
+    history_[i].Save(&out[out.size() - Census::kSavedSize]);
+  }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+
+#include <deque>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "cyclic_vector.hpp"
+
+// Сводка итерации: население, рождения и смерти по сравнению с предыдущей
+// итерацией и прямоугольник, ограничивающий живые клетки. У поля без живых
+// клеток прямоугольник пуст: min_row_ > max_row_.
+struct Census {
+  // Размер сводки в Save и Load.
+  static const size_t kSavedSize = 8;
+
+  uint64_t generation_ = 0;
+  uint64_t population_ = 0;
+  uint64_t births_ = 0;
+  uint64_t deaths_ = 0;
+  long long min_row_ = LLONG_MAX;
+  long long max_row_ = -1;
+  long long min_col_ = LLONG_MAX;
+  long long max_col_ = -1;
+
+  // Учет строки row, живые клетки которой лежат в столбцах
+  // [min_col, max_col].
+  void AddRow(const long long row, const long long min_col,
+              const long long max_col) {
+    min_row_ = row < min_row_ ? row : min_row_;
+    max_row_ = row > max_row_ ? row : max_row_;
+    min_col_ = min_col < min_col_ ? min_col : min_col_;
+    max_col_ = max_col > max_col_ ? max_col : max_col_;
+  }
+
+  // Прибавление сводки другой части поля той же итерации.
+  void Merge(const Census& other);
+
+  void Save(long long* data) const;
+  void Load(const long long* data);
+
+  void PrintCsv(std::ostream& out) const;
+  static void PrintCsvHeader(std::ostream& out);
+};
+
+// Сводка строк [begin, end) поля без рождений и смертей. Номера строк в
+// сводке сдвигаются на offset.
+Census CountCensus(const CyclicVector<CyclicVector<char>>& field,
+                   const long long begin, const long long end,
+                   const long long offset = 0);
+
+// Ряд сводок по итерациям: последние kHistorySize в памяти и, по желанию,
+// все - в файл CSV.
+class CensusLog {
+ public:
+  static const size_t kHistorySize = 1 << 16;
+
+ public:
+  // Очистка истории. Запись в файл продолжается.
+  void Clear();
+
+  void Add(const Census& census);
+
+  // Запись каждой следующей сводки в файл filename.
+  bool Record(const std::string& filename);
+
+  void StopRecording();
+
+  bool Recording() const {
+    return file_.is_open();
+  }
+
+  bool Empty() const {
+    return history_.empty();
+  }
+
+  // Последняя сводка, история не должна быть пуста.
+  const Census& Last() const {
+    return history_.back();
+  }
+
+  // Вывод последних count сводок таблицей.
+  void Print(std::ostream& out, const size_t count) const;
+
+  // Сохранение последних count сводок по Census::kSavedSize чисел, старые
+  // первыми.
+  void Save(const size_t count, std::vector<long long>& out) const;
+
+ private:
+  std::deque<Census> history_;
+  std::ofstream file_;
+};
@@ -0,0 +1,60 @@
+#include "edits.hpp"
+#include "field_io.hpp"
+
+EditQueue::~EditQueue() {
+  std::vector<CellEdit> edits;
+  Drain(edits);
+}
+
+void EditQueue::Push(std::vector<CellEdit> edits) {
+  Node* node = new Node{std::move(edits),
+                        head_.load(std::memory_order_relaxed)};
+  while (!head_.compare_exchange_weak(node->next_, node,
+                                      std::memory_order_release,
+                                      std::memory_order_relaxed)) {
+  }
+}
+
+bool EditQueue::Drain(std::vector<CellEdit>& edits) {
+  edits.clear();
+  Node* node = head_.exchange(nullptr, std::memory_order_acquire);
+  if (node == nullptr) {
+    return false;
+  }
+  // Стек пачек разворачивается в порядок добавления.
+  Node* reversed = nullptr;
+  while (node != nullptr) {
+    Node* next = node->next_;
+    node->next_ = reversed;
+    reversed = node;
+    node = next;
+  }
+  while (reversed != nullptr) {
+    Node* next = reversed->next_;
+    edits.insert(edits.end(), reversed->edits_.begin(),
+                 reversed->edits_.end());
+    delete reversed;
+    reversed = next;
+  }
+  return true;
+}
+
+bool LoadPatternEdits(const std::string& filename, const long long x,
+                      const long long y, std::vector<CellEdit>& edits) {
+  MappedFile file(filename);
+  CyclicVector<CyclicVector<char>> pattern;
+  std::string rules;
+  bool loaded = IsRleBoard(file) ? LoadRleBoard(file, pattern, rules)
+                                 : LoadCsvBoard(file, pattern);
+  if (!loaded) {
+    return false;
+  }
+  edits.clear();
+  for (size_t i = 0; i < pattern.size(); ++i) {
+    for (size_t j = 0; j < pattern[i].size(); ++j) {
+      edits.push_back({y + static_cast<long long>(i),
+                       x + static_cast<long long>(j), pattern[i][j]});
+    }
+  }
+  return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Правка клетки в строке row_ столбца column_ поля. Координаты берутся по
+// модулю размеров поля.
+struct CellEdit {
+  long long row_;
+  long long column_;
+  char alive_;
+};
+
+// Очередь правок без блокировок: правки добавляет кто угодно, забирает
+// все разом один поток между итерациями.
+class EditQueue {
+ public:
+  EditQueue() : head_(nullptr) {
+  }
+
+  ~EditQueue();
+
+  EditQueue(const EditQueue&) = delete;
+  EditQueue& operator=(const EditQueue&) = delete;
+
+  void Push(std::vector<CellEdit> edits);
+
+  // Забирает все правки в порядке добавления. Возвращает false, если
+  // очередь пуста.
+  bool Drain(std::vector<CellEdit>& edits);
+
+ private:
+  struct Node {
+    std::vector<CellEdit> edits_;
+    Node* next_;
+  };
+
+  std::atomic<Node*> head_;  // Последняя добавленная пачка.
+};
+
+// Правки, вставляющие паттерн из файла .rle или .csv левым верхним углом в
+// столбец x строки y. Прямоугольник паттерна перезаписывается целиком.
+bool LoadPatternEdits(const std::string& filename, const long long x,
+                      const long long y, std::vector<CellEdit>& edits);
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+
+#include <string>
+
+// Общий интерфейс движков игры: то, что нужно, чтобы провести поле через
+// несколько итераций без интерактивного режима.
+class Engine {
+ public:
+  virtual ~Engine() = default;
+
+  // Создание поля h_size x v_size со случайными клетками.
+  virtual bool Start(const size_t h_size, const size_t v_size) = 0;
+
+  // Загрузка поля из файла .csv, паттерна RLE или двоичного файла поля.
+  virtual bool Start(const std::string& filename, const size_t h_size,
+                     const size_t v_size) = 0;
+
+  // Запуск num_iterations итераций.
+  virtual bool Run(const size_t num_iterations) = 0;
+
+  // Ожидание окончания запущенных итераций.
+  virtual bool Wait() = 0;
+
+  // Сохранение остановленного поля в двоичный файл.
+  virtual bool Save(const std::string& filename) = 0;
+
+  // Запись сводки каждой следующей итерации в файл CSV.
+  virtual bool RecordCensus(const std::string& filename) = 0;
+
+  // Остановка вычислений и завершение работы.
+  virtual void Quit() = 0;
+};
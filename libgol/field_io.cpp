@@ -0,0 +1,454 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include "field_io.hpp"
+#include "rules.hpp"
+
+const char kBoardMagic[4] = {'G', 'O', 'L', 'B'};
+const uint32_t kBoardVersion = 1;
+
+// MappedFile
+
+MappedFile::MappedFile(const std::string& filename)
+    : data_(nullptr),
+      size_(0) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+    void* data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd,
+                      0);
+    if (data != MAP_FAILED) {
+      // Файл читается один раз от начала до конца.
+      madvise(data, file_stat.st_size, MADV_SEQUENTIAL);
+      data_ = static_cast<const char*>(data);
+      size_ = file_stat.st_size;
+    }
+  }
+  // Отображение остается действительным и после закрытия файла.
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+// Двоичный формат поля
+
+void FillBoardHeader(BoardHeader& header, const size_t height,
+                     const size_t width, const std::string& rules,
+                     const size_t generation, const bool packed) {
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic_, kBoardMagic, sizeof(kBoardMagic));
+  header.version_ = kBoardVersion;
+  header.height_ = height;
+  header.width_ = width;
+  header.generation_ = generation;
+  header.encoding_ = packed ? BoardHeader::Bits : BoardHeader::Bytes;
+  std::strncpy(header.rules_, rules.c_str(), sizeof(header.rules_) - 1);
+}
+
+bool IsValidBoardHeader(const BoardHeader& header) {
+  return std::memcmp(header.magic_, kBoardMagic, sizeof(kBoardMagic)) == 0 &&
+         header.version_ == kBoardVersion && header.height_ != 0 &&
+         header.width_ != 0;
+}
+
+bool IsBinaryBoard(const MappedFile& file) {
+  return file.IsOpen() && file.Size() >= sizeof(BoardHeader) &&
+         std::memcmp(file.Data(), kBoardMagic, sizeof(kBoardMagic)) == 0;
+}
+
+bool LoadBinaryBoard(const MappedFile& file,
+                     CyclicVector<CyclicVector<char>>& field,
+                     std::string& rules, size_t& generation) {
+  if (!IsBinaryBoard(file)) {
+    return false;
+  }
+  BoardHeader header;
+  std::memcpy(&header, file.Data(), sizeof(header));
+  size_t row_size = header.encoding_ == BoardHeader::Bits
+                        ? (header.width_ + 7) / 8
+                        : header.width_;
+  if (!IsValidBoardHeader(header) ||
+      (file.Size() - sizeof(header)) / row_size < header.height_) {
+    return false;
+  }
+
+  // Строки раскладываются прямо из отображенных страниц.
+  field.assign(header.height_, CyclicVector<char>());
+  const unsigned char* data =
+      reinterpret_cast<const unsigned char*>(file.Data()) + sizeof(header);
+  for (auto& line : field) {
+    if (header.encoding_ == BoardHeader::Bits) {
+      line.resize(header.width_);
+      char* cells = line.data();
+      for (size_t j = 0; j < header.width_; ++j) {
+        cells[j] = static_cast<char>((data[j / 8] >> (j % 8)) & 1);
+      }
+    } else {
+      line.assign(data, data + header.width_);
+    }
+    data += row_size;
+  }
+
+  header.rules_[sizeof(header.rules_) - 1] = '\0';
+  rules = header.rules_;
+  generation = header.generation_;
+  return true;
+}
+
+bool SaveBinaryBoard(const std::string& filename,
+                     const CyclicVector<CyclicVector<char>>& field,
+                     const std::string& rules, const size_t generation,
+                     const bool packed) {
+  if (field.empty()) {
+    return false;
+  }
+  std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+  if (!fout) {
+    return false;
+  }
+
+  BoardHeader header;
+  FillBoardHeader(header, field.size(), field[0].size(), rules, generation,
+                  packed);
+  fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  std::vector<char> row((header.width_ + 7) / 8);
+  for (const auto& line : field) {
+    if (!packed) {
+      fout.write(line.data(), line.size());
+      continue;
+    }
+    std::fill(row.begin(), row.end(), 0);
+    for (size_t j = 0; j < line.size(); ++j) {
+      row[j / 8] |= static_cast<char>((line[j] & 1) << (j % 8));
+    }
+    fout.write(row.data(), row.size());
+  }
+  fout.close();
+  return static_cast<bool>(fout);
+}
+
+bool SaveBinaryBoardAtomically(const std::string& filename,
+                               const CyclicVector<CyclicVector<char>>& field,
+                               const std::string& rules,
+                               const size_t generation) {
+  std::string temporary = filename + ".tmp";
+  if (!SaveBinaryBoard(temporary, field, rules, generation)) {
+    std::remove(temporary.c_str());
+    return false;
+  }
+  return std::rename(temporary.c_str(), filename.c_str()) == 0;
+}
+
+// CSV
+
+namespace {
+
+// Число клеток в строке .csv файла.
+size_t CsvRowWidth(const char* begin, const char* end) {
+  size_t width = 0;
+  for (const char* c = begin; c != end; ++c) {
+    if (*c != ',' && *c != '\r') {
+      ++width;
+    }
+  }
+  return width;
+}
+
+void ParseCsvRow(const char* begin, const char* end, CyclicVector<char>& line) {
+  line.resize(CsvRowWidth(begin, end));
+  char* cells = line.data();
+  for (const char* c = begin; c != end; ++c) {
+    if (*c != ',' && *c != '\r') {
+      *cells++ = static_cast<char>(*c - '0');
+    }
+  }
+}
+
+}  // namespace
+
+bool LoadCsvBoard(const MappedFile& file,
+                  CyclicVector<CyclicVector<char>>& field,
+                  const size_t num_threads) {
+  if (!file.IsOpen()) {
+    return false;
+  }
+
+  // Границы строк ищем memchr: он просматривает память машинными словами
+  // или векторными регистрами, а не по символу.
+  std::vector<const char*> row_begins;
+  const char* data = file.Data();
+  const char* file_end = data + file.Size();
+  while (data < file_end) {
+    const char* row_end = static_cast<const char*>(
+        std::memchr(data, '\n', file_end - data));
+    if (row_end == nullptr) {
+      row_end = file_end;
+    }
+    if (row_end != data && !(row_end == data + 1 && *data == '\r')) {
+      row_begins.push_back(data);
+    }
+    data = row_end + 1;
+  }
+  if (row_begins.empty()) {
+    return false;
+  }
+
+  // Строки независимы, поэтому разбираются параллельно.
+  field.assign(row_begins.size(), CyclicVector<char>());
+  auto parse_rows = [&](const size_t first, const size_t last) {
+    for (size_t i = first; i < last; ++i) {
+      const char* end = static_cast<const char*>(
+          std::memchr(row_begins[i], '\n', file_end - row_begins[i]));
+      ParseCsvRow(row_begins[i], end == nullptr ? file_end : end, field[i]);
+    }
+  };
+  size_t threads_count = std::max<size_t>(
+      1, std::min(num_threads, row_begins.size()));
+  std::vector<std::thread> threads;
+  for (size_t t = 1; t < threads_count; ++t) {
+    threads.emplace_back(parse_rows, row_begins.size() * t / threads_count,
+                         row_begins.size() * (t + 1) / threads_count);
+  }
+  parse_rows(0, row_begins.size() / threads_count);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (const auto& line : field) {
+    if (line.empty() || line.size() != field[0].size()) {
+      field.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+// RLE
+
+namespace {
+
+// Пропуск строк комментариев "#..." и пустых строк.
+const char* SkipRleComments(const char* data, const char* end) {
+  while (data < end) {
+    if (*data == '#') {
+      data = static_cast<const char*>(std::memchr(data, '\n', end - data));
+      if (data == nullptr) {
+        return end;
+      }
+    } else if (!std::isspace(static_cast<unsigned char>(*data))) {
+      break;
+    }
+    ++data;
+  }
+  return data;
+}
+
+// Перевод правил из RLE (B3/S23 или S/B вида 23/3, у Generations еще
+// /C3 или третья часть S/B/C) в вид b3/s23 или b2/s/c3. Правила Larger than
+// Life (R5,C0,M1,S34..58,B34..45,NM) переводятся в нижний регистр.
+std::string RleRules(const std::string& rule) {
+  if (!rule.empty() && (rule[0] == 'r' || rule[0] == 'R')) {
+    std::string result = rule;
+    for (auto& c : result) {
+      c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return result;
+  }
+  std::string born;
+  std::string stay;
+  std::string states;
+  size_t slash = rule.find('/');
+  if (rule.find_first_of("bB") != std::string::npos) {
+    char part = 'b';
+    for (auto c : rule) {
+      if (c == 'b' || c == 'B' || c == 's' || c == 'S' || c == 'c' ||
+          c == 'C') {
+        part = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+      } else if (c >= '0' && c <= '9') {
+        (part == 'b' ? born : part == 's' ? stay : states) += c;
+      }
+    }
+  } else if (slash != std::string::npos) {
+    stay = rule.substr(0, slash);
+    born = rule.substr(slash + 1);
+    size_t second = born.find('/');
+    if (second != std::string::npos) {
+      states = born.substr(second + 1);
+      born.resize(second);
+    }
+  } else {
+    return "";
+  }
+  return "b" + born + "/s" + stay + (states.empty() ? "" : "/c" + states);
+}
+
+// Разбор заголовка паттерна RLE: x = m, y = n[, rule = B3/S23].
+// Возвращает конец строки заголовка.
+const char* ParseRleHeader(const MappedFile& file, size_t& width,
+                           size_t& height, std::string& rules) {
+  const char* end = file.Data() + file.Size();
+  const char* data = SkipRleComments(file.Data(), end);
+  const char* header_end = static_cast<const char*>(
+      std::memchr(data, '\n', end - data));
+  if (header_end == nullptr) {
+    header_end = end;
+  }
+  std::string header(data, header_end);
+  header.erase(std::remove_if(header.begin(), header.end(), [](char c) {
+    return std::isspace(static_cast<unsigned char>(c));
+  }), header.end());
+  rules.clear();
+  size_t position = 0;
+  while (position < header.size()) {
+    size_t next = header.find(',', position);
+    if (next == std::string::npos) {
+      next = header.size();
+    }
+    std::string item = header.substr(position, next - position);
+    size_t equals = item.find('=');
+    if (equals != std::string::npos) {
+      std::string key = item.substr(0, equals);
+      std::string value = item.substr(equals + 1);
+      if (key == "x" || key == "X") {
+        width = std::strtoull(value.c_str(), nullptr, 10);
+      } else if (key == "y" || key == "Y") {
+        height = std::strtoull(value.c_str(), nullptr, 10);
+      } else if (key == "rule") {
+        // Правила Larger than Life сами содержат запятые, поэтому правилами
+        // считается весь остаток заголовка.
+        rules = RleRules(header.substr(position + equals + 1));
+        break;
+      }
+    }
+    position = next + 1;
+  }
+  return header_end;
+}
+
+}  // namespace
+
+bool IsRleBoard(const MappedFile& file) {
+  if (!file.IsOpen()) {
+    return false;
+  }
+  const char* data = SkipRleComments(file.Data(), file.Data() + file.Size());
+  return data < file.Data() + file.Size() && (*data == 'x' || *data == 'X');
+}
+
+bool LoadRleBoard(const MappedFile& file,
+                  CyclicVector<CyclicVector<char>>& field, std::string& rules,
+                  const size_t min_height, const size_t min_width) {
+  if (!IsRleBoard(file)) {
+    return false;
+  }
+  const char* end = file.Data() + file.Size();
+  size_t width = 0;
+  size_t height = 0;
+  const char* data = ParseRleHeader(file, width, height, rules);
+  if (width == 0 || height == 0) {
+    return false;
+  }
+
+  size_t field_height = std::max(height, min_height);
+  size_t field_width = std::max(width, min_width);
+  size_t top = (field_height - height) / 2;
+  size_t left = (field_width - width) / 2;
+  field.assign(field_height, CyclicVector<char>());
+  for (auto& line : field) {
+    line.assign(field_width, 0);
+  }
+
+  // Тело: <число>b - мертвые клетки, <число>o - живые, <число>$ - конец
+  // строк, ! - конец паттерна. У паттернов с несколькими состояниями . -
+  // мертвые клетки, A..X - состояния 1..24, с приставкой p..y - следующие
+  // по 24 состояния.
+  size_t i = 0;
+  size_t j = 0;
+  size_t count = 0;
+  int state_prefix = 0;
+  // С правилами на два состояния любая непустая клетка жива.
+  int states = rules.empty() ? 2 : ParseRules(rules).states_;
+  bool two_states = states == 2;
+  for (; data < end && *data != '!'; ++data) {
+    char c = *data;
+    if (c >= '0' && c <= '9') {
+      count = count * 10 + (c - '0');
+      continue;
+    }
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      continue;
+    }
+    if (c >= 'p' && c <= 'y') {
+      state_prefix = (c - 'p' + 1) * 24;
+      continue;
+    }
+    size_t run = count == 0 ? 1 : count;
+    count = 0;
+    if (c == '$') {
+      i += run;
+      j = 0;
+    } else if (c == 'b' || c == '.') {
+      j += run;
+    } else if (c == '#') {
+      // Комментарий после тела паттерна.
+      data = static_cast<const char*>(std::memchr(data, '\n', end - data));
+      if (data == nullptr) {
+        break;
+      }
+    } else {
+      if (i >= height || j + run > width) {
+        field.clear();
+        return false;
+      }
+      int state = c >= 'A' && c <= 'X' && !two_states
+                      ? state_prefix + (c - 'A' + 1)
+                      : 1;
+      state_prefix = 0;
+      // Состояние должно быть у правил паттерна и помещаться в байт.
+      if (state >= states || state >= kMaxStates) {
+        field.clear();
+        return false;
+      }
+      char* cells = field[top + i].data() + left + j;
+      std::fill(cells, cells + run, static_cast<char>(state));
+      j += run;
+    }
+  }
+  return true;
+}
+
+std::string LoadBoardRules(const std::string& filename) {
+  MappedFile file(filename);
+  if (IsBinaryBoard(file)) {
+    BoardHeader header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+    header.rules_[sizeof(header.rules_) - 1] = '\0';
+    return header.rules_;
+  }
+  std::string rules;
+  if (IsRleBoard(file)) {
+    size_t width = 0;
+    size_t height = 0;
+    ParseRleHeader(file, width, height, rules);
+  }
+  return rules;
+}
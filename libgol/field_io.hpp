@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string>
+
+#include "cyclic_vector.hpp"
+
+// Отображение файла в память только для чтения.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& filename);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool IsOpen() const {
+    return data_ != nullptr;
+  }
+
+  const char* Data() const {
+    return data_;
+  }
+
+  size_t Size() const {
+    return size_;
+  }
+
+ private:
+  const char* data_;
+  size_t size_;
+};
+
+// Заголовок двоичного файла поля. За ним следуют строки поля: по биту на
+// клетку (клетка j - бит j % 8 байта j / 8 строки) или по байту на клетку.
+struct BoardHeader {
+  enum Encoding : uint32_t {
+    Bytes,
+    Bits
+  };
+
+  char magic_[4];           // "GOLB"
+  uint32_t version_;
+  uint64_t height_;
+  uint64_t width_;
+  uint64_t generation_;     // Номер итерации, на которой сохранено поле.
+  uint32_t encoding_;
+  uint32_t reserved_;
+  char rules_[32];          // Правила игры, строка с нулем на конце.
+};
+
+// Заполнение заголовка двоичного файла поля.
+void FillBoardHeader(BoardHeader& header, const size_t height,
+                     const size_t width, const std::string& rules,
+                     const size_t generation, const bool packed);
+
+// Проверка сигнатуры, версии и размеров заголовка.
+bool IsValidBoardHeader(const BoardHeader& header);
+
+// Является ли отображенный файл двоичным файлом поля.
+bool IsBinaryBoard(const MappedFile& file);
+
+// Загрузка поля из двоичного файла. Правила и номер итерации берутся из
+// заголовка. Возвращает false, если файл поврежден.
+bool LoadBinaryBoard(const MappedFile& file,
+                     CyclicVector<CyclicVector<char>>& field,
+                     std::string& rules, size_t& generation);
+
+// Сохранение поля в двоичный файл.
+bool SaveBinaryBoard(const std::string& filename,
+                     const CyclicVector<CyclicVector<char>>& field,
+                     const std::string& rules, const size_t generation,
+                     const bool packed = true);
+
+// Сохранение поля через временный файл <filename>.tmp, который затем
+// переименовывается: файл filename всегда остается целым.
+bool SaveBinaryBoardAtomically(const std::string& filename,
+                               const CyclicVector<CyclicVector<char>>& field,
+                               const std::string& rules,
+                               const size_t generation);
+
+// Загрузка поля из .csv файла: строка файла - строка поля, клетки через
+// запятую. Строки разбираются в num_threads потоков. Возвращает false, если
+// поле пустое или строки разной длины.
+bool LoadCsvBoard(const MappedFile& file,
+                  CyclicVector<CyclicVector<char>>& field,
+                  const size_t num_threads = 1);
+
+// Является ли отображенный файл паттерном в формате RLE.
+bool IsRleBoard(const MappedFile& file);
+
+// Загрузка паттерна в формате RLE. Паттерн помещается в центр поля размера
+// не меньше min_height x min_width. Правила из заголовка паттерна, если они
+// есть, возвращаются в виде b3/s23, b2/s/c3 или r5,c0,m1,s34..58,b34..45,nm,
+// иначе rules остается пустой. Клетки паттернов с несколькими состояниями
+// получают номер состояния; состояние, которого нет у правил паттерна, -
+// ошибка.
+bool LoadRleBoard(const MappedFile& file,
+                  CyclicVector<CyclicVector<char>>& field, std::string& rules,
+                  const size_t min_height = 0, const size_t min_width = 0);
+
+// Правила из заголовка двоичного файла поля или паттерна RLE без загрузки
+// поля. Пустая строка, если правил в файле нет.
+std::string LoadBoardRules(const std::string& filename);
@@ -0,0 +1,111 @@
+#include <algorithm>
+
+#include "field_view.hpp"
+
+namespace {
+
+// Символы по доле живых клеток блока: ни одной, меньше половины, не меньше
+// половины, все.
+const char* const kDensityGlyphs[4] = {"\u2591", "\u2592", "\u2593",
+                                       "\u2588"};
+
+// Число живых клеток строки в столбцах [begin, end), целые плитки берутся
+// из tiles.
+size_t CountRange(const CyclicVector<char>& line,
+                  const std::vector<uint16_t>& tiles, size_t begin,
+                  const size_t end) {
+  size_t count = 0;
+  const char* cells = line.data();
+  while (begin < end) {
+    if (begin % kTileWidth == 0 && begin + kTileWidth <= end) {
+      count += tiles[begin / kTileWidth];
+      begin += kTileWidth;
+    } else {
+      count += cells[begin] & 1;
+      ++begin;
+    }
+  }
+  return count;
+}
+
+void AppendLine(std::string& frame, const char* left, const char* right,
+                const size_t width) {
+  frame += left;
+  for (size_t i = 0; i < width; ++i) {
+    frame += "\u2550";
+  }
+  frame += right;
+  frame += '\n';
+}
+
+}  // namespace
+
+void CountTiles(const CyclicVector<char>& line, std::vector<uint16_t>& tiles) {
+  tiles.assign((line.size() + kTileWidth - 1) / kTileWidth, 0);
+  const char* cells = line.data();
+  for (size_t j = 0; j < line.size(); ++j) {
+    tiles[j / kTileWidth] += cells[j] & 1;
+  }
+}
+
+void CountTiles(const CyclicVector<CyclicVector<char>>& field,
+                TilePopulation& population) {
+  population.resize(field.size());
+  for (size_t i = 0; i < field.size(); ++i) {
+    CountTiles(field[i], population[i]);
+  }
+}
+
+std::string RenderView(const CyclicVector<CyclicVector<char>>& field,
+                       const TilePopulation& population, const long long x,
+                       const long long y, size_t w, size_t h, size_t zoom) {
+  const size_t height = field.size();
+  const size_t width = field[0].size();
+  w = std::min(w, width);
+  h = std::min(h, height);
+  zoom = std::max<size_t>(zoom, 1);
+  const size_t left = ((x % static_cast<long long>(width)) + width) % width;
+  const size_t top = ((y % static_cast<long long>(height)) + height) % height;
+  const size_t columns = (w + zoom - 1) / zoom;
+  const size_t rows = (h + zoom - 1) / zoom;
+
+  // Все символы занимают по 3 байта в UTF-8.
+  std::string frame;
+  frame.reserve((rows + 2) * ((columns + 2) * 3 + 1));
+  AppendLine(frame, "\u2554", "\u2557", columns);
+
+  std::vector<size_t> counts(columns);
+  for (size_t r = 0; r < rows; ++r) {
+    const size_t row_begin = r * zoom;
+    const size_t row_end = std::min(h, row_begin + zoom);
+    std::fill(counts.begin(), counts.end(), 0);
+    for (size_t i = row_begin; i < row_end; ++i) {
+      const size_t row = (top + i) % height;
+      const auto& line = field[row];
+      const auto& tiles = population[row];
+      for (size_t c = 0; c < columns; ++c) {
+        // Блок столбцов разбивается на две части, если переходит через край.
+        size_t begin = (left + c * zoom) % width;
+        size_t length = std::min(w, (c + 1) * zoom) - c * zoom;
+        size_t first = std::min(length, width - begin);
+        counts[c] += CountRange(line, tiles, begin, begin + first);
+        if (first < length) {
+          counts[c] += CountRange(line, tiles, 0, length - first);
+        }
+      }
+    }
+
+    frame += "\u2551";
+    for (size_t c = 0; c < columns; ++c) {
+      size_t cells = (row_end - row_begin) *
+                     (std::min(w, (c + 1) * zoom) - c * zoom);
+      size_t level = counts[c] == 0 ? 0
+                     : counts[c] == cells ? 3
+                     : counts[c] * 2 < cells ? 1 : 2;
+      frame += kDensityGlyphs[level];
+    }
+    frame += "\u2551\n";
+  }
+  AppendLine(frame, "\u255A", "\u255D", columns);
+  return frame;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string>
+#include <vector>
+
+#include "cyclic_vector.hpp"
+
+// Плитка - kTileWidth подряд идущих клеток одной строки. Население плиток
+// хранится вместе с полем, и плотность крупных блоков вида считается по
+// плиткам, а не по клеткам.
+const size_t kTileWidth = 64;
+
+using TilePopulation = CyclicVector<std::vector<uint16_t>>;
+
+// Подсчет населения плиток строки.
+void CountTiles(const CyclicVector<char>& line, std::vector<uint16_t>& tiles);
+
+// Подсчет населения плиток всего поля.
+void CountTiles(const CyclicVector<CyclicVector<char>>& field,
+                TilePopulation& population);
+
+// Кадр окна из w x h клеток поля с левым верхним углом в столбце x строки y.
+// Окно может переходить через край поля. При zoom > 1 каждый блок
+// zoom x zoom клеток выводится одним символом по доле живых клеток.
+std::string RenderView(const CyclicVector<CyclicVector<char>>& field,
+                       const TilePopulation& population, const long long x,
+                       const long long y, size_t w, size_t h, size_t zoom);
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <vector>
+
+#include "census.hpp"
+#include "cyclic_vector.hpp"
+#include "rules.hpp"
+
+// Расчет строк [begin, end) по правилам Larger than Life (см. CalculateRows).
+// Число живых клеток окрестности считается скользящими суммами: суммы
+// столбцов высотой 2r + 1 сдвигаются вниз на строку, сумма окна по ним -
+// вправо на столбец. На клетку приходится O(1) операций при любом радиусе,
+// строки полосы дороже остальных только на начальные суммы.
+template <class RowDone>
+void CalculateRangeRows(const CyclicVector<CyclicVector<char>>& field,
+                        CyclicVector<CyclicVector<char>>& new_field,
+                        const Rules& rules, const long long begin,
+                        const long long end, const long long row_offset,
+                        Census& census, RowDone row_done) {
+  if (begin >= end) {
+    return;
+  }
+  const long long radius = rules.radius_;
+  const long long width = static_cast<long long>(field[begin].size());
+  std::vector<int> columns(width, 0);
+  for (long long i = begin - radius; i <= begin + radius; ++i) {
+    const char* line = field[i].data();
+    for (long long j = 0; j < width; ++j) {
+      columns[j] += line[j];
+    }
+  }
+
+  for (long long i = begin; i < end; ++i) {
+    if (i > begin) {
+      const char* entering = field[i + radius].data();
+      const char* leaving = field[i - radius - 1].data();
+      for (long long j = 0; j < width; ++j) {
+        columns[j] += entering[j] - leaving[j];
+      }
+    }
+    const char* mid = field[i].data();
+    char* out = new_field[i].data();
+    // Окно столбцов [j - r, j + r] замкнуто по ширине поля.
+    int sum = 0;
+    for (long long j = -radius; j <= radius; ++j) {
+      sum += columns[(j % width + width) % width];
+    }
+    long long entering = (radius + 1) % width;
+    long long leaving = ((-radius) % width + width) % width;
+    bool changed = false;
+    long long first_alive = -1;
+    long long last_alive = -1;
+    for (long long j = 0; j < width; ++j) {
+      int count = rules.middle_ ? sum : sum - mid[j];
+      const int* range = mid[j] ? rules.stay_range_ : rules.born_range_;
+      char alive = count >= range[0] && count <= range[1] ? 1 : 0;
+      out[j] = alive;
+      changed = changed || alive != mid[j];
+      if (alive) {
+        first_alive = first_alive < 0 ? j : first_alive;
+        last_alive = j;
+        ++census.population_;
+        census.births_ += !mid[j];
+      } else {
+        census.deaths_ += mid[j];
+      }
+      sum += columns[entering] - columns[leaving];
+      entering = entering + 1 == width ? 0 : entering + 1;
+      leaving = leaving + 1 == width ? 0 : leaving + 1;
+    }
+    if (first_alive >= 0) {
+      census.AddRow(i + row_offset, first_alive, last_alive);
+    }
+    row_done(i, changed);
+  }
+}
+
+// Расчет строк [begin, end) следующей итерации поля field в new_field по
+// правилам rules. Поле замкнуто в тор. Сводка посчитанных строк
+// прибавляется к census, номера строк в ней сдвигаются на row_offset. После
+// каждой строки вызывается row_done(i, changed), где changed - изменилась
+// ли строка. Читаются строки [begin - r, end + r), где r - радиус правил.
+template <class RowDone>
+void CalculateRows(const CyclicVector<CyclicVector<char>>& field,
+                   CyclicVector<CyclicVector<char>>& new_field,
+                   const Rules& rules, const long long begin,
+                   const long long end, const long long row_offset,
+                   Census& census, RowDone row_done) {
+  if (rules.radius_ > 1) {
+    CalculateRangeRows(field, new_field, rules, begin, end, row_offset,
+                       census, row_done);
+    return;
+  }
+  for (long long i = begin; i < end; ++i) {
+    const char* up = field[i - 1].data();
+    const char* mid = field[i].data();
+    const char* down = field[i + 1].data();
+    char* out = new_field[i].data();
+    long long width = static_cast<long long>(field[i].size());
+    bool changed = false;
+    long long first_alive = -1;
+    long long last_alive = -1;
+    // Сводка считается заодно с полем, без отдельного прохода.
+    for (long long j = 0; j < width; ++j) {
+      long long left = j == 0 ? width - 1 : j - 1;
+      long long right = j + 1 == width ? 0 : j + 1;
+      int num_alive = up[left] + up[j] + up[right] + mid[left] + mid[right] +
+                      down[left] + down[j] + down[right];
+      char alive = rules.next_[static_cast<size_t>(mid[j])][num_alive];
+      out[j] = alive;
+      changed = changed || alive != mid[j];
+      if (alive) {
+        first_alive = first_alive < 0 ? j : first_alive;
+        last_alive = j;
+        ++census.population_;
+        census.births_ += !mid[j];
+      } else {
+        census.deaths_ += mid[j];
+      }
+    }
+    if (first_alive >= 0) {
+      census.AddRow(i + row_offset, first_alive, last_alive);
+    }
+    row_done(i, changed);
+  }
+}
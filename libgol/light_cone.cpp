@@ -0,0 +1,65 @@
+#include <algorithm>
+
+#include "census.hpp"
+#include "kernel.hpp"
+#include "light_cone.hpp"
+
+LightCone CutLightCone(const CyclicVector<CyclicVector<char>>& field,
+                       const long long x, const long long y, size_t w,
+                       size_t h, const size_t generations,
+                       const size_t radius) {
+  LightCone cone;
+  long long height = field.size();
+  long long width = field[0].size();
+  w = std::min<size_t>(w, width);
+  h = std::min<size_t>(h, height);
+  size_t reach = generations * radius;
+  cone.generations_ = generations;
+  cone.radius_ = radius;
+  cone.rows_ = h;
+  cone.columns_ = w;
+  cone.full_height_ = h + 2 * reach >= static_cast<size_t>(height);
+  cone.full_width_ = w + 2 * reach >= static_cast<size_t>(width);
+  // Конус во все поле начинается с окна: поле замкнуто, отступ не нужен.
+  cone.row_margin_ = cone.full_height_ ? 0 : reach;
+  cone.column_margin_ = cone.full_width_ ? 0 : reach;
+  long long rows = cone.full_height_ ? height : h + 2 * reach;
+  long long columns = cone.full_width_ ? width : w + 2 * reach;
+  long long top = y - static_cast<long long>(cone.row_margin_);
+  long long left = x - static_cast<long long>(cone.column_margin_);
+
+  cone.cells_.resize(rows);
+  for (long long i = 0; i < rows; ++i) {
+    const auto& line = field[top + i];
+    cone.cells_[i].resize(columns);
+    for (long long j = 0; j < columns; ++j) {
+      cone.cells_[i][j] = line[left + j];
+    }
+  }
+  return cone;
+}
+
+CyclicVector<CyclicVector<char>> AdvanceLightCone(LightCone& cone,
+                                                  const Rules& rules) {
+  long long rows = cone.cells_.size();
+  CyclicVector<CyclicVector<char>> next = cone.cells_;
+  Census census;
+  // Конус замкнут в тор по своим краям, поэтому ошибка от краев
+  // расползается на радиус за итерацию - ровно до окна за generations_
+  // итераций. Строки, до которых она уже дошла, не считаются.
+  for (size_t step = 1; step <= cone.generations_; ++step) {
+    long long margin = cone.full_height_ ? 0 : step * cone.radius_;
+    CalculateRows(cone.cells_, next, rules, margin, rows - margin, 0, census,
+                  [](const long long, const bool) {});
+    cone.cells_.swap(next);
+  }
+
+  CyclicVector<CyclicVector<char>> region;
+  region.resize(cone.rows_);
+  for (size_t i = 0; i < cone.rows_; ++i) {
+    const auto& line = cone.cells_[cone.row_margin_ + i];
+    region[i].assign(line.begin() + cone.column_margin_,
+                     line.begin() + cone.column_margin_ + cone.columns_);
+  }
+  return region;
+}
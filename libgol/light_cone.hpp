@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+
+#include "cyclic_vector.hpp"
+#include "rules.hpp"
+
+// Световой конус окна: часть поля, от которой зависит окно через
+// generations итераций, - окно, расширенное на generations * radius клеток
+// в каждую сторону, но не больше поля.
+struct LightCone {
+  CyclicVector<CyclicVector<char>> cells_;
+  size_t generations_;
+  size_t radius_;      // Радиус окрестности правил.
+  size_t row_margin_;  // Отступ окна от края конуса.
+  size_t column_margin_;
+  size_t rows_;        // Размер окна.
+  size_t columns_;
+  bool full_height_;   // Конус занимает поле по высоте (ширине) целиком и
+  bool full_width_;    // замкнут так же, как поле.
+};
+
+// Вырезка из поля светового конуса окна w x h с левым верхним углом в
+// столбце x строки y для правил с радиусом окрестности radius. Окно может
+// переходить через край поля.
+LightCone CutLightCone(const CyclicVector<CyclicVector<char>>& field,
+                       const long long x, const long long y, size_t w,
+                       size_t h, const size_t generations,
+                       const size_t radius = 1);
+
+// Состояние окна через cone.generations_ итераций. Каждая итерация считает
+// только строки, еще влияющие на окно, так что расчет стоит
+// O(g * (w + 2gr) * (h + 2gr)), а не O(g * поле). Конус портится.
+CyclicVector<CyclicVector<char>> AdvanceLightCone(LightCone& cone,
+                                                  const Rules& rules);
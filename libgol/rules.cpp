@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "rules.hpp"
+
+namespace {
+
+// Разбор числа с позиции pos. Возвращает false, если числа там нет.
+bool ParseNumber(const std::string& rules, size_t& pos, int& value) {
+  size_t begin = pos;
+  value = 0;
+  while (pos < rules.size() && rules[pos] >= '0' && rules[pos] <= '9') {
+    if (value < 1000000) {
+      value = value * 10 + (rules[pos] - '0');
+    }
+    ++pos;
+  }
+  return pos > begin;
+}
+
+// Разбор отрезка вида 34..58 или 34 с позиции pos. Пустой отрезок (за
+// буквой сразу запятая или конец строки) записывается как [1, 0].
+bool ParseRange(const std::string& rules, size_t& pos, int* range) {
+  range[0] = 1;
+  range[1] = 0;
+  if (pos == rules.size() || rules[pos] == ',') {
+    return true;
+  }
+  if (!ParseNumber(rules, pos, range[0])) {
+    return false;
+  }
+  range[1] = range[0];
+  if (rules.compare(pos, 2, "..") != 0) {
+    return true;
+  }
+  pos += 2;
+  return ParseNumber(rules, pos, range[1]);
+}
+
+// Разбор правил Larger than Life: поля r, c, m, s, b, n через запятую в
+// любом порядке. Поддерживаются два состояния и окрестность Мура.
+bool ParseRangeRules(const std::string& rules, Rules& result) {
+  result.ranges_ = true;
+  result.states_ = 2;
+  result.radius_ = 0;
+  result.middle_ = false;
+  result.born_range_[0] = result.stay_range_[0] = 1;
+  result.born_range_[1] = result.stay_range_[1] = 0;
+  size_t pos = 0;
+  while (pos < rules.size()) {
+    char key = static_cast<char>(std::tolower(rules[pos++]));
+    int value = 0;
+    bool ok = true;
+    if (key == 'r') {
+      ok = ParseNumber(rules, pos, result.radius_);
+    } else if (key == 'c') {
+      ok = ParseNumber(rules, pos, value) && value <= 2;
+    } else if (key == 'm') {
+      ok = ParseNumber(rules, pos, value) && value <= 1;
+      result.middle_ = value == 1;
+    } else if (key == 's') {
+      ok = ParseRange(rules, pos, result.stay_range_);
+    } else if (key == 'b') {
+      ok = ParseRange(rules, pos, result.born_range_);
+    } else if (key == 'n') {
+      ok = pos < rules.size() && std::tolower(rules[pos++]) == 'm';
+    } else {
+      ok = false;
+    }
+    if (!ok || (pos < rules.size() && rules[pos++] != ',')) {
+      return false;
+    }
+  }
+  return result.radius_ >= 1 && result.radius_ <= kMaxRadius;
+}
+
+bool InRange(const int* range, const int count) {
+  return count >= range[0] && count <= range[1];
+}
+
+}  // namespace
+
+Rules ParseRules(const std::string& rules) {
+  Rules result;
+  size_t first = rules.find_first_not_of(" \t");
+  if (first != std::string::npos && std::tolower(rules[first]) == 'r') {
+    if (!ParseRangeRules(rules.substr(first), result)) {
+      return ParseRules("b3/s23");
+    }
+    // Окрестности радиуса 1 считаются обычным ядром по next_.
+    std::memset(result.next_, 0, sizeof(result.next_));
+    for (int alive = 0; alive < 2 && result.radius_ == 1; ++alive) {
+      for (int n = 0; n <= 8; ++n) {
+        int count = n + (result.middle_ ? alive : 0);
+        result.next_[alive][n] = InRange(
+            alive ? result.stay_range_ : result.born_range_, count) ? 1 : 0;
+      }
+    }
+    return result;
+  }
+
+  result.ranges_ = false;
+  result.radius_ = 1;
+  result.middle_ = false;
+  result.born_range_[0] = result.born_range_[1] = 0;
+  result.stay_range_[0] = result.stay_range_[1] = 0;
+  int states = 0;
+  bool set_born = true;
+  bool set_states = false;  // Цифры после c - число состояний.
+  for (const auto& c : rules) {
+    if (c == 'b' || c == 'B') {
+      set_born = true;
+      set_states = false;
+    } else if (c == 's' || c == 'S') {
+      set_born = false;
+      set_states = false;
+    } else if (c == 'c' || c == 'C') {
+      set_states = true;
+    } else if (c == '/') {
+      set_born = !set_born;
+      set_states = false;
+      continue;
+    } else if (c >= '0' && c <= '9' && set_states) {
+      states = std::min(states * 10 + (c - '0'), kMaxStates + 1);
+    } else if (c >= '0' && c <= '9') {
+      if (set_born) {
+        result.born_.push_back(c - '0');
+      } else {
+        result.stay_.push_back(c - '0');
+      }
+    }
+  }
+
+  // При плохих входных данных устанавливаем b3/s23.
+  if (result.born_.empty() && result.stay_.empty()) {
+    result.born_.push_back(3);
+    result.stay_.push_back(2);
+    result.stay_.push_back(3);
+  }
+  if (states > kMaxStates) {
+    return ParseRules("b3/s23");
+  }
+  result.states_ = std::max(states, 2);
+
+  // Соседей не больше восьми, цифра 9 ни на что не влияет.
+  std::memset(result.next_, 0, sizeof(result.next_));
+  for (auto num_to_be_born : result.born_) {
+    if (num_to_be_born <= 8) {
+      result.next_[0][static_cast<size_t>(num_to_be_born)] = 1;
+    }
+  }
+  for (auto num_to_stay : result.stay_) {
+    if (num_to_stay <= 8) {
+      result.next_[1][static_cast<size_t>(num_to_stay)] = 1;
+    }
+  }
+  return result;
+}
+
+std::string RulesString(const Rules& rules) {
+  if (rules.ranges_) {
+    // c0 и nm подразумеваются: строка должна поместиться в заголовок файла.
+    auto range = [](const int* range) {
+      if (range[0] > range[1]) {
+        return std::string();
+      }
+      return std::to_string(range[0]) + ".." + std::to_string(range[1]);
+    };
+    return "r" + std::to_string(rules.radius_) + ",m" +
+           (rules.middle_ ? "1" : "0") + ",s" + range(rules.stay_range_) +
+           ",b" + range(rules.born_range_);
+  }
+
+  std::string result = "b";
+  for (auto num_to_be_born : rules.born_) {
+    result += static_cast<char>('0' + num_to_be_born);
+  }
+  result += "/s";
+  for (auto num_to_stay : rules.stay_) {
+    result += static_cast<char>('0' + num_to_stay);
+  }
+  if (rules.states_ > 2) {
+    result += "/c" + std::to_string(rules.states_);
+  }
+  return result;
+}
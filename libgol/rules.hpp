@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Наибольший радиус окрестности: с ним правила еще помещаются в заголовок
+// двоичного файла поля.
+const int kMaxRadius = 31;
+
+// Наибольшее число состояний правил Generations: состояние помещается в
+// байт.
+const int kMaxStates = 256;
+
+// Правила игры. Числа окружающих живых ячеек, при которых
+struct Rules {
+  std::vector<char> born_;  // ячейка рождается,
+  std::vector<char> stay_;  // ячейка остается жить.
+  // Новое состояние клетки по старому и числу живых соседей.
+  char next_[2][9];
+
+  // Число состояний клетки. У правил Generations (вида b2/s/c3) больше двух:
+  // 0 - мертва, 1 - жива, 2..states_ - 1 - угасает. Угасающая клетка не
+  // считается живой соседкой и через итерацию переходит в следующее
+  // состояние, из последнего - в 0. Живая клетка, которая не остается жить,
+  // начинает угасать.
+  int states_;
+
+  // Правила Larger than Life (вида r5,c0,m1,s34..58,b34..45,nm): радиус
+  // окрестности Мура, входит ли в нее сама клетка и отрезки числа живых
+  // клеток окрестности, при которых клетка рождается и остается жить. У
+  // правил вида b3/s23 radius_ = 1 и ranges_ = false. При radius_ = 1
+  // next_ заполняется и для отрезков.
+  bool ranges_;
+  int radius_;
+  bool middle_;
+  int born_range_[2];
+  int stay_range_[2];
+};
+
+// Разбор правил вида b3/s23, b2/s/c3 или r5,c0,m1,s34..58,b34..45,nm. При
+// ошибке устанавливаются b3/s23.
+Rules ParseRules(const std::string& rules);
+
+// Правила в виде строки b3/s23, b2/s/c3 или r5,m1,s34..58,b34..45: у
+// Larger than Life поля c0 и nm опускаются.
+std::string RulesString(const Rules& rules);
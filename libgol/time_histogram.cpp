@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <iomanip>
+
+#include "time_histogram.hpp"
+
+const size_t TimeHistogram::kBucketsCount;
+const size_t TimeHistogram::kSavedSize;
+
+TimeHistogram::TimeHistogram() {
+  Reset();
+}
+
+void TimeHistogram::Add(const uint64_t nanoseconds) {
+  size_t bucket = nanoseconds == 0 ? 0 : 63 - __builtin_clzll(nanoseconds);
+  Bump(buckets_[bucket], 1);
+  Bump(count_, 1);
+  Bump(total_, nanoseconds);
+  if (nanoseconds > max_.load(std::memory_order_relaxed)) {
+    max_.store(nanoseconds, std::memory_order_relaxed);
+  }
+}
+
+void TimeHistogram::Merge(const TimeHistogram& other) {
+  for (size_t i = 0; i < kBucketsCount; ++i) {
+    Bump(buckets_[i], other.buckets_[i].load(std::memory_order_relaxed));
+  }
+  Bump(count_, other.Count());
+  Bump(total_, other.TotalNanoseconds());
+  max_.store(std::max(MaxNanoseconds(), other.MaxNanoseconds()),
+             std::memory_order_relaxed);
+}
+
+void TimeHistogram::Reset() {
+  for (auto& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  total_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t TimeHistogram::Count() const {
+  return count_.load(std::memory_order_relaxed);
+}
+
+uint64_t TimeHistogram::TotalNanoseconds() const {
+  return total_.load(std::memory_order_relaxed);
+}
+
+uint64_t TimeHistogram::MaxNanoseconds() const {
+  return max_.load(std::memory_order_relaxed);
+}
+
+uint64_t TimeHistogram::PercentileNanoseconds(const double share) const {
+  uint64_t count = Count();
+  if (count == 0) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(share * (count - 1)) + 1;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBucketsCount; ++i) {
+    uint64_t in_bucket = buckets_[i].load(std::memory_order_relaxed);
+    if (seen + in_bucket >= rank) {
+      // Длительности считаются равномерно распределенными внутри корзины.
+      double lower = i == 0 ? 0 : static_cast<double>(uint64_t(1) << i);
+      double upper = 2 * lower + (i == 0 ? 2 : 0);
+      double estimate = lower + (upper - lower) * (rank - seen) / in_bucket;
+      return std::min(static_cast<uint64_t>(estimate), MaxNanoseconds());
+    }
+    seen += in_bucket;
+  }
+  return MaxNanoseconds();
+}
+
+void TimeHistogram::Save(std::vector<uint64_t>& out) const {
+  for (const auto& bucket : buckets_) {
+    out.push_back(bucket.load(std::memory_order_relaxed));
+  }
+  out.push_back(Count());
+  out.push_back(TotalNanoseconds());
+  out.push_back(MaxNanoseconds());
+}
+
+void TimeHistogram::Load(const uint64_t* data) {
+  for (size_t i = 0; i < kBucketsCount; ++i) {
+    buckets_[i].store(data[i], std::memory_order_relaxed);
+  }
+  count_.store(data[kBucketsCount], std::memory_order_relaxed);
+  total_.store(data[kBucketsCount + 1], std::memory_order_relaxed);
+  max_.store(data[kBucketsCount + 2], std::memory_order_relaxed);
+}
+
+void TimeHistogram::PrintHeader(std::ostream& out) {
+  out << std::left << std::setw(16) << "phase" << std::right
+      << std::setw(10) << "count" << std::setw(12) << "total ms"
+      << std::setw(12) << "mean us" << std::setw(12) << "p50 us"
+      << std::setw(12) << "p99 us" << std::setw(12) << "max us" << "\n";
+}
+
+void TimeHistogram::PrintRow(std::ostream& out,
+                             const std::string& name) const {
+  uint64_t count = Count();
+  double total = static_cast<double>(TotalNanoseconds());
+  auto flags = out.flags();
+  auto precision = out.precision();
+  out << std::left << std::setw(16) << name << std::right << std::fixed
+      << std::setprecision(1) << std::setw(10) << count << std::setw(12)
+      << total / 1e6 << std::setw(12) << (count ? total / count / 1e3 : 0.0)
+      << std::setw(12) << PercentileNanoseconds(0.5) / 1e3 << std::setw(12)
+      << PercentileNanoseconds(0.99) / 1e3 << std::setw(12)
+      << MaxNanoseconds() / 1e3 << "\n";
+  out.flags(flags);
+  out.precision(precision);
+}
+
+void TimeHistogram::PrintJson(std::ostream& out) const {
+  out << "{\"count\": " << Count()
+      << ", \"total_ns\": " << TotalNanoseconds()
+      << ", \"p50_ns\": " << PercentileNanoseconds(0.5)
+      << ", \"p90_ns\": " << PercentileNanoseconds(0.9)
+      << ", \"p99_ns\": " << PercentileNanoseconds(0.99)
+      << ", \"max_ns\": " << MaxNanoseconds() << ", \"buckets\": [";
+  // Хвост пустых корзин не выводится.
+  size_t used = kBucketsCount;
+  while (used > 0 && buckets_[used - 1].load(std::memory_order_relaxed) == 0) {
+    --used;
+  }
+  for (size_t i = 0; i < used; ++i) {
+    out << (i == 0 ? "" : ", ")
+        << buckets_[i].load(std::memory_order_relaxed);
+  }
+  out << "]}";
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Гистограмма длительностей в наносекундах: корзина i хранит число
+// длительностей из [2^i, 2^(i+1)). Пишет в гистограмму один поток, читать
+// можно из любого во время записи: счетчики атомарные, но обновляются без
+// read-modify-write, поэтому запись почти ничего не стоит.
+class TimeHistogram {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static const size_t kBucketsCount = 64;
+  // Размер гистограммы в Save: корзины, число, сумма и максимум.
+  static const size_t kSavedSize = kBucketsCount + 3;
+
+ public:
+  TimeHistogram();
+
+  TimeHistogram(const TimeHistogram&) = delete;
+  TimeHistogram& operator=(const TimeHistogram&) = delete;
+
+  void Add(const uint64_t nanoseconds);
+
+  void Add(const Clock::time_point begin, const Clock::time_point end) {
+    Add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin)
+            .count());
+  }
+
+  // Добавление длительности от begin до текущего момента.
+  void AddSince(const Clock::time_point begin) {
+    Add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - begin).count());
+  }
+
+  // Прибавление всех длительностей other.
+  void Merge(const TimeHistogram& other);
+
+  // Сброс. Безопасен, только пока в гистограмму никто не пишет.
+  void Reset();
+
+  uint64_t Count() const;
+  uint64_t TotalNanoseconds() const;
+  uint64_t MaxNanoseconds() const;
+
+  // Оценка перцентиля share: длительности внутри корзины считаются
+  // распределенными равномерно.
+  uint64_t PercentileNanoseconds(const double share) const;
+
+  // Дописывает kSavedSize чисел в out, Load читает их обратно.
+  void Save(std::vector<uint64_t>& out) const;
+  void Load(const uint64_t* data);
+
+  // Строка таблицы: имя, число, сумма в мс, среднее, p50, p99 и максимум в
+  // мкс.
+  void PrintRow(std::ostream& out, const std::string& name) const;
+
+  // Объект JSON с теми же величинами в наносекундах и корзинами.
+  void PrintJson(std::ostream& out) const;
+
+  // Заголовок таблицы для PrintRow.
+  static void PrintHeader(std::ostream& out);
+
+ private:
+  static void Bump(std::atomic<uint64_t>& counter, const uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<uint64_t> buckets_[kBucketsCount];
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> total_;
+  std::atomic<uint64_t> max_;
+};
@@ -0,0 +1,164 @@
+#!/bin/bash
+# Замер сильной (поле фиксировано) и слабой (число строк растет вместе с
+# числом потоков или рабов) масштабируемости gol_pthread и gol_mpi. Каждая
+# конфигурация запускается отдельно: поле создается, прогревается, затем
+# замеряются generations итераций командами run и wait. Результат - CSV в
+# stdout, ход замера - в stderr.
+
+usage() {
+  cat <<EOF
+Usage: $0 --engine pthread|mpi --binary <path> [options]
+Options:
+  --mode strong|weak|both   scaling mode (both)
+  --procs <p,...>           threads for pthread, slave ranks for mpi (1,2,4)
+  --size <n>                field is n x n for strong scaling, (n * p) x n for
+                            weak scaling (1024)
+  --generations <n>         measured iterations (100)
+  --warmup <n>              iterations before measuring (10)
+  --rules <rules>           game rules (b3/s23)
+  --launcher <command>      mpi launcher, -np is appended (mpirun)
+  --engine-args <args>      extra arguments of the binary, e.g. "rma sparse"
+  --log-dir <dir>           keep output of every run in <dir>
+Efficiency is relative to the first value of --procs.
+EOF
+}
+
+engine=""
+binary=""
+mode="both"
+procs="1,2,4"
+size=1024
+generations=100
+warmup=10
+rules="b3/s23"
+launcher="mpirun"
+engine_args=""
+log_dir=""
+
+while [ $# -gt 0 ]; do
+  if [ $# -lt 2 ]; then
+    usage >&2
+    exit 1
+  fi
+  case "$1" in
+    --engine) engine="$2" ;;
+    --binary) binary="$2" ;;
+    --mode) mode="$2" ;;
+    --procs) procs="$2" ;;
+    --size) size="$2" ;;
+    --generations) generations="$2" ;;
+    --warmup) warmup="$2" ;;
+    --rules) rules="$2" ;;
+    --launcher) launcher="$2" ;;
+    --engine-args) engine_args="$2" ;;
+    --log-dir) log_dir="$2" ;;
+    *) usage >&2; exit 1 ;;
+  esac
+  shift 2
+done
+
+if [ "$engine" != "pthread" ] && [ "$engine" != "mpi" ] ||
+   [ ! -x "$binary" ]; then
+  usage >&2
+  exit 1
+fi
+case "$mode" in
+  strong) modes="strong" ;;
+  weak) modes="weak" ;;
+  both) modes="strong weak" ;;
+  *) usage >&2; exit 1 ;;
+esac
+if [ -n "$log_dir" ]; then
+  mkdir -p "$log_dir" || exit 1
+fi
+
+# Запуск одной конфигурации: p потоков или рабов, поле rows x cols. Выводит
+# "<секунды> <доля синхронизации>". Поле, которое программа выводит при
+# выходе, отбрасывается.
+run_once() {
+  local p=$1 rows=$2 cols=$3
+  local commands="start $rows $cols\n"
+  if [ "$warmup" -gt 0 ]; then
+    commands+="run $warmup\nwait\n"
+  fi
+  commands+="stats reset\nrun $generations\nwait\nstats json\nquit\n"
+
+  local output
+  if [ "$engine" = "pthread" ]; then
+    output=$(printf "$commands" | "$binary" "$rules" "$p" $engine_args |
+             grep -E 'Finished in|total_ns')
+  else
+    output=$(printf "$commands" |
+             $launcher -np $((p + 1)) "$binary" "$rules" $engine_args |
+             grep -E 'Finished in|total_ns')
+  fi
+  if [ -n "$log_dir" ]; then
+    echo "$output" > "$log_dir/$engine-$current_mode-$p-${rows}x$cols.log"
+  fi
+
+  # Время - из последнего wait. В статистике строки потоков начинаются с
+  # "compute", строки рабов - с "rank"; первая длительность в строке -
+  # вычисления, остальные - барьер и блокировка или ожидание границ и
+  # балансировка.
+  echo "$output" | awk '
+    /Finished in/ { seconds = $3 }
+    /\{"compute"|\{"rank"/ {
+      line = $0
+      first = 1
+      while (match(line, /"total_ns": [0-9]+/)) {
+        value = substr(line, RSTART + 12, RLENGTH - 12) + 0
+        if (first) {
+          compute += value
+          first = 0
+        } else {
+          other += value
+        }
+        line = substr(line, RSTART + RLENGTH)
+      }
+    }
+    END {
+      if (seconds == "") {
+        exit 1
+      }
+      share = compute + other > 0 ? other / (compute + other) : 0
+      printf "%s %.4f\n", seconds, share
+    }'
+}
+
+echo "engine,mode,procs,rows,cols,generations,seconds_per_generation," \
+     "comm_share,speedup,efficiency" | tr -d ' '
+for current_mode in $modes; do
+  base_time=""
+  base_p=""
+  for p in ${procs//,/ }; do
+    rows=$size
+    if [ "$current_mode" = "weak" ]; then
+      rows=$((size * p))
+    fi
+    echo "$engine $current_mode: $p, field ${rows}x$size" >&2
+    result=$(run_once "$p" "$rows" "$size")
+    if [ $? -ne 0 ] || [ -z "$result" ]; then
+      echo "$engine $current_mode: run with $p failed" >&2
+      continue
+    fi
+    read seconds share <<< "$result"
+    per_generation=$(awk -v s="$seconds" -v n="$generations" \
+                     'BEGIN { printf "%.6g", (n > 0 ? s / n : s) }')
+    if [ -z "$base_time" ]; then
+      base_time=$per_generation
+      base_p=$p
+    fi
+    # Сильная: ускорение T(p0) / T(p), эффективность ускорение * p0 / p.
+    # Слабая: эффективность T(p0) / T(p), ускорение эффективность * p / p0.
+    read speedup efficiency <<< $(awk -v t0="$base_time" -v t="$per_generation" \
+        -v p0="$base_p" -v p="$p" -v mode="$current_mode" 'BEGIN {
+      ratio = t > 0 ? t0 / t : 0
+      if (mode == "strong") {
+        printf "%.4f %.4f\n", ratio, ratio * p0 / p
+      } else {
+        printf "%.4f %.4f\n", ratio * p / p0, ratio
+      }
+    }')
+    echo "$engine,$current_mode,$p,$rows,$size,$generations,$per_generation,$share,$speedup,$efficiency"
+  done
+done